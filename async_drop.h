@@ -0,0 +1,87 @@
+#ifndef MY_ASYNC_DROP
+#define MY_ASYNC_DROP
+
+#include<condition_variable>
+#include<deque>
+#include<memory>
+#include<mutex>
+#include<thread>
+
+
+// Whatever is handed to AsyncDrop is destroyed by its destructor
+struct Garbage {
+    virtual ~Garbage() = default;
+};
+
+// Background thread freeing dropped data structures, so the thread that let
+// go of a large tree does not pay for its teardown. Started on first use and
+// joined at exit after the queue is drained.
+class AsyncDrop {
+public:
+    static void Drop(std::unique_ptr<Garbage> garbage) {
+        AsyncDrop& dropper = Instance();
+        {
+            std::lock_guard<std::mutex> lock(dropper.mutex_);
+            dropper.queue_.push_back(std::move(garbage));
+            ++dropper.pending_;
+        }
+        dropper.wake_.notify_all();
+    }
+    // wait until everything dropped so far is destroyed
+    static void Wait() {
+        AsyncDrop& dropper = Instance();
+        std::unique_lock<std::mutex> lock(dropper.mutex_);
+        dropper.done_.wait(lock, [&dropper] {
+            return dropper.pending_ == 0;
+        });
+    }
+
+    AsyncDrop(const AsyncDrop&) = delete;
+    AsyncDrop& operator=(const AsyncDrop&) = delete;
+    ~AsyncDrop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        worker_.join();
+    }
+private:
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::deque<std::unique_ptr<Garbage>> queue_;
+    // queued or being destroyed
+    std::size_t pending_ = 0;
+    bool stop_ = false;
+    std::thread worker_;
+
+    AsyncDrop() : worker_(&AsyncDrop::Work, this) {}
+
+    static AsyncDrop& Instance() {
+        static AsyncDrop dropper;
+        return dropper;
+    }
+
+    void Work() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this] {
+                return stop_ || !queue_.empty();
+            });
+            if (queue_.empty()) {
+                return;
+            }
+            std::unique_ptr<Garbage> garbage = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            garbage = nullptr;
+            lock.lock();
+            if (--pending_ == 0) {
+                done_.notify_all();
+            }
+        }
+    }
+};
+
+#endif
@@ -1,66 +1,168 @@
 #ifndef MY_B_TREE
 #define MY_B_TREE
-#ifdef ENABLE_LOGGING
-    #include <iostream>
-    #define LOG_DEBUG(msg) do { std::cerr << "[DEBUG] " << msg << std::endl; } while(0)
-    #define LOG_DEBUG_EXPR(expr) do { std::cerr << "[DEBUG] " << #expr << " = " << (expr) << std::endl; } while(0)
-#else
-    #define LOG_DEBUG(msg) do {} while(0)
-    #define LOG_DEBUG_EXPR(expr) do {} while(0)
-#endif
-
 #include<iostream>
 #include<vector>
 #include<algorithm>
 #include<memory>
+#include<iterator>
+#include<optional>
+#include<bit>
+#include<span>
+#include<utility>
+#include<concepts>
+#include"node_keys.h"
+#include"node_search.h"
+#include"tree_stats.h"
+#include"find_task.h"
+#include"node_arena.h"
+#include"tree_profiler.h"
+#include"async_drop.h"
+#include"lookup_filter.h"
+#include"hot_index.h"
+#include"slot_marks.h"
+#include"tree_aggregate.h"
+#ifdef __linux__
+    #include<unistd.h>
+#endif
 
 
+// Order == kRuntimeOrder selects node limits chosen at construction
+// instead of the compile-time Order.
+constexpr int kRuntimeOrder = 0;
+
+inline std::size_t CacheLineSize() {
+#if defined(__linux__) && defined(_SC_LEVEL1_DCACHE_LINESIZE)
+    long line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+    if (line > 0) {
+        return static_cast<std::size_t>(line);
+    }
+#endif
+    return 64;
+}
+
 template <typename T, int Order>
-class BTree {
+class NodeLimits {
 public:
-    struct Node {
-        std::vector<T> keys;
-        std::vector<std::unique_ptr<Node> > childs;
+    static constexpr int LeafOrder() {
+        return Order;
+    }
+    static constexpr int InternalOrder() {
+        return Order;
+    }
+};
+
+template <typename T>
+class NodeLimits<T, kRuntimeOrder> {
+public:
+    // cache lines spanned by the keys (and child pointers) of one node
+    static constexpr std::size_t kLinesPerNode = 4;
+
+    // leaves hold keys only, internal nodes a key and a child pointer per slot
+    NodeLimits()
+        : leaf_order_(OrderFor(kLinesPerNode * CacheLineSize() / sizeof(T)))
+        , internal_order_(OrderFor(kLinesPerNode * CacheLineSize() / (sizeof(T) + sizeof(void*)))) {}
+    NodeLimits(int leaf_order, int internal_order)
+        : leaf_order_(std::max(leaf_order, 3))
+        , internal_order_(std::max(internal_order, 3)) {}
+
+    int LeafOrder() const {
+        return leaf_order_;
+    }
+    int InternalOrder() const {
+        return internal_order_;
+    }
+private:
+    static int OrderFor(std::size_t slots) {
+        return std::max(static_cast<int>(slots), 3);
+    }
+
+    int leaf_order_;
+    int internal_order_;
+};
+
+
+// Storage = HugePageNodes allocates nodes (and child arrays) from the
+// per-thread huge-page NodeArena, see HugePageBTree.
+template <typename T, int Order, typename Keys = SortedKeys<T>, typename Storage = HeapNodes,
+          typename Search = ScanSearch, typename Augment = NoAugment>
+class BTree : private NodeLimits<T, Order> {
+    static constexpr bool kAugmented = !std::is_same_v<Augment, NoAugment>;
+public:
+    struct Node;
+    struct InternalNode;
+    struct NodeDeleter {
+        void operator()(Node* node) const {
+            if (node->leaf) {
+                delete node;
+            } else {
+                delete static_cast<InternalNode*>(node);
+            }
+        }
+    };
+    using NodePtr = std::unique_ptr<Node, NodeDeleter>;
+    // Leaves are plain Nodes, only InternalNode has children. The tree knows
+    // the height of every node it walks (0 for leaves), so nodes are never
+    // asked what they are; leaf is read when a node is freed and by outside code.
+    // Whoever changes keys directly calls Refit afterwards. Keys move between
+    // nodes through the methods taking a marked flag, which carry the lazy
+    // delete mark along, see EnableLazyDelete.
+    struct Node : Storage::NodeBase {
+        Keys keys;
+        SlotMarks marks;
+        bool leaf = true;
+        [[no_unique_address]] typename Search::Model route;
+        // of the subtree, see Augment
+        [[no_unique_address]] typename Augment::Value aggregate;
         Node() = default;
         Node(T key) {
-            keys.push_back(key);
-        }
-        Node(T key, std::unique_ptr<Node> left_child, std::unique_ptr<Node> right_child) {
-            keys.push_back(key);
-            childs.push_back(left_child);
-            childs.push_back(right_child);
+            keys.Insert(std::move(key));
+            Refit();
         }
-        void InsertKey(T key) {
-            int i = static_cast<int>(keys.size()) - 1;
-            keys.push_back(key); // make space
-            while (i >= 0 && keys[i] > key) {
-                keys[i + 1] = keys[i];
-                --i;
+        void InsertKey(T key, bool marked = false) {
+            if (marked || marks.Any()) {
+                marks.InsertAt(keys.LowerBound(key), marked);
             }
-            keys[i + 1] = key;
+            keys.Insert(std::move(key));
+            Refit();
         }
         void DeleteKey(const T& key) {
-            auto it = std::find(keys.begin(), keys.end(), key);
-            if (it != keys.end()) {
-                keys.erase(it);
+            std::size_t idx = LowerBound(key);
+            if (idx < keys.size() && keys.KeyEquals(idx, key)) {
+                marks.EraseAt(idx);
+                keys.EraseAt(idx);
+                Refit();
             }
         }
-        void AddChild(std::unique_ptr<Node> child) {
-            childs.push_back(std::move(child));
+        T TakeKey(std::size_t idx, bool& marked) {
+            marked = marks.EraseAt(idx);
+            return keys.ExtractAt(idx);
         }
-        void AddChild(typename std::vector<std::unique_ptr<Node> >::iterator pos, std::unique_ptr<Node> child) {
-            childs.insert(pos, std::move(child));
+        // put key, marked as given, in place of the key at idx, which is
+        // returned with its mark in marked
+        T SwapKey(std::size_t idx, T key, bool& marked) {
+            bool old_marked = marks.Test(idx);
+            marks.Set(idx, marked);
+            marked = old_marked;
+            return keys.Replace(idx, std::move(key));
         }
-        void DeleteChild(std::size_t idx) {
-            childs.erase(childs.begin() + idx);
+        T SplitKeys(std::size_t mid, Node& right, bool& marked) {
+            marked = marks.SplitAt(mid, right.marks);
+            return keys.SplitAt(mid, right.keys);
         }
-        bool HasKey(T key) {
-            for (T key_ : keys) {
-                if (key_ == key) {
-                    return true;
-                }
-            }
-            return false;
+        // every key of other, which all lie before (front) or after ours
+        void AbsorbKeys(Node& other, bool front) {
+            marks.Absorb(std::move(other.marks), keys.size(), other.keys.size(), front);
+            keys.Absorb(std::move(other.keys));
+        }
+        bool HasKey(const T& key) {
+            std::size_t idx = LowerBound(key);
+            return idx < keys.size() && keys.KeyEquals(idx, key);
+        }
+        std::size_t LowerBound(const T& key) const {
+            return Search::LowerBound(route, keys, key);
+        }
+        void Refit() {
+            Search::Fit(route, keys);
         }
         bool Is2Node() {
             return keys.size() == 1;
@@ -68,8 +170,8 @@ public:
         bool Is3Node() {
             return keys.size() == 2;
         }
-        bool IsLeaf() {
-            return childs.size() == 0;
+        bool IsLeaf() const {
+            return leaf;
         }
         std::size_t KeysQuantity() {
             return keys.size();
@@ -81,66 +183,487 @@ public:
                 if (i > 0) os << ", ";
                 os << n.keys[i];
             }
-            os << "], children: " << n.childs.size() << ")";
+            os << "], children: " << n.Children().size() << ")";
             return os;
         }
         void Print() {
-            std::cout << "Node(keys: [";
-            for (size_t i = 0; i < keys.size(); ++i) {
-                if (i > 0) std::cout << ", ";
-                std::cout << keys[i];
+            std::cout << *this << std::endl;
+        }
+        // for code outside the tree, empty for leaves
+        std::span<const NodePtr> Children() const {
+            if (leaf) {
+                return {};
             }
-            std::cout << "], children: " << childs.size() << ")" << std::endl;
+            const auto& childs = static_cast<const InternalNode*>(this)->childs;
+            return {childs.data(), childs.size()};
+        }
+    };
+    struct InternalNode : Node {
+        std::vector<NodePtr, typename Storage::template Allocator<NodePtr>> childs;
+        InternalNode() {
+            this->leaf = false;
+        }
+        void AddChild(NodePtr child) {
+            childs.push_back(std::move(child));
+        }
+        void DeleteChild(std::size_t idx) {
+            childs.erase(childs.begin() + idx);
         }
     };
-    std::unique_ptr<Node> root;
+    // Finger into the tree: the root-to-node path of the last hinted operation,
+    // with the key range covered by every node on it. Any modification made
+    // without this cursor invalidates it and the next hinted call restarts at root.
+    class Cursor {
+        friend class BTree;
+        struct Level {
+            Node* node;
+            std::optional<T> low;
+            std::optional<T> high;
+            std::size_t child_idx;
+        };
+        std::vector<Level> path_;
+        std::size_t version_ = 0;
+    };
+    NodePtr root;
+private:
+    // deleted keys still stored in the nodes, see EnableLazyDelete
+    struct LazyDeletes {
+        std::size_t marked = 0;
+        double max_density;
+    };
+    enum class KeyState { kAbsent, kLive, kMarked };
+
+    std::size_t size_ = 0;
+    // of root, 0 while it is a leaf
+    int height_ = 0;
+    // all keys, sorted, while the tree is small: root is null then, see SetFlatLimit
+    std::vector<T, typename Storage::template Allocator<T>> flat_;
+    std::size_t flat_limit_ = 0;
+    std::size_t version_ = 0;
+    // what only some trees use, allocated on first use: a small tree holds
+    // its flat keys and a null pointer
+    struct Extras {
+        TreeStats stats;
+        std::optional<LazyDeletes> lazy;
+        std::unique_ptr<LookupFilter<T>> filter;
+        std::unique_ptr<HotIndex<T, Node*>> hot;
+        // leftmost and rightmost leaf, null until needed and whenever a node is
+        // created or freed (splits, merges, root changes)
+        Node* min_leaf = nullptr;
+        Node* max_leaf = nullptr;
+    };
+    std::unique_ptr<Extras> extras_;
 public:
+    BTree() = default;
+    // limits of a BTree<T, kRuntimeOrder>, both clamped to at least 3
+    BTree(int leaf_order, int internal_order)
+        : NodeLimits<T, Order>(leaf_order, internal_order) {
+        static_assert(Order == kRuntimeOrder, "node limits of a compile-time Order are fixed");
+    }
+    BTree(BTree&& other) noexcept
+        : NodeLimits<T, Order>(other)
+        , root(std::move(other.root))
+        , size_(std::exchange(other.size_, 0))
+        , height_(std::exchange(other.height_, 0))
+        , flat_(std::move(other.flat_))
+        , flat_limit_(other.flat_limit_)
+        , version_(other.version_)
+        , extras_(std::move(other.extras_)) {
+        ++other.version_;
+    }
+    BTree& operator=(BTree&& other) noexcept {
+        if (this != &other) {
+            Clear();
+            NodeLimits<T, Order>::operator=(other);
+            root = std::move(other.root);
+            size_ = std::exchange(other.size_, 0);
+            height_ = std::exchange(other.height_, 0);
+            flat_ = std::move(other.flat_);
+            other.flat_.clear();
+            flat_limit_ = other.flat_limit_;
+            // cursors of either tree must restart
+            version_ = std::max(version_, other.version_) + 1;
+            ++other.version_;
+            extras_ = std::move(other.extras_);
+        }
+        return *this;
+    }
+    ~BTree() {
+        Clear();
+    }
+    int LeafOrder() const {
+        return NodeLimits<T, Order>::LeafOrder();
+    }
+    const TreeStats& Stats() const {
+        static const TreeStats kNone;
+        return extras_ ? extras_->stats : kNone;
+    }
+    int InternalOrder() const {
+        return NodeLimits<T, Order>::InternalOrder();
+    }
+    // levels below root, 0 while root is a leaf
+    int Height() const {
+        return height_;
+    }
     void FixRootOverflow() {
         if (!root) {
             return;
         }
-        if (root->KeysQuantity() >= Order) {
-            std::unique_ptr<Node> new_root = std::make_unique<Node>();
+        if (height_ == 0 && root->marks.Any() && root->KeysQuantity() >= static_cast<std::size_t>(NodeOrder(0))) {
+            // like SplitChild, a full leaf drops its marked keys first
+            Purge(root.get(), 1);
+        }
+        if (root->KeysQuantity() >= static_cast<std::size_t>(NodeOrder(height_))) {
+            auto* new_root = new InternalNode();
             new_root->AddChild(std::move(root));
-            root = std::move(new_root);
-            SplitChild(root.get(), 0);
+            root = NodePtr(new_root);
+            ++height_;
+            SplitChild(Internal(root.get()), 0, height_);
+            Reaggregate(root.get(), height_);
         }
     }
     void Insert(T key) {
+        PROFILE_OP(TreeOp::kInsert);
         // no duplicates
-        if (Find(key)) {
+        KeyState state = Probe(key);
+        if (state != KeyState::kAbsent) {
+            if (state == KeyState::kMarked) {
+                Revive(key);
+            }
             return;
         }
+        ++version_;
+        ++size_;
+        FilterAdd(key);
+        if (root == nullptr && flat_.size() < flat_limit_) {
+            flat_.insert(flat_.begin() + FlatLowerBound(key), std::move(key));
+            return;
+        }
+        Materialize();
+        InsertIntoNodes(std::move(key));
+    }
+    template <typename... Args>
+    void Emplace(Args&&... args) {
+        Insert(T(std::forward<Args>(args)...));
+    }
+    // Insert starting from the deepest node of hint whose range covers key,
+    // then leave hint on key. Splits climb only as far as nodes overflow.
+    void Insert(Cursor& hint, const T& key) {
+        PROFILE_OP(TreeOp::kInsert);
         if (root == nullptr) {
-            root = std::make_unique<Node>(key);
+            Insert(key);
+            Find(hint, key);
+            return;
+        }
+        Locate(hint, key);
+        if (Seek(hint, key)) {
+            Revive(hint);
             return;
         }
-        RecursiveInsert(root.get(), key);
+        ++size_;
+        FilterAdd(key);
+        hint.path_.back().node->InsertKey(key);
+        std::size_t level = hint.path_.size() - 1;
+        while (level > 0 && SplitChild(Internal(hint.path_[level - 1].node), hint.path_[level - 1].child_idx,
+                                       height_ - static_cast<int>(level - 1))) {
+            --level;
+        }
+        if constexpr (kAugmented) {
+            // the split nodes below level are redone already, those above gained a key
+            for (std::size_t i = level + 1; i-- > 0;) {
+                Reaggregate(hint.path_[i].node, height_ - static_cast<int>(i));
+            }
+        }
+        Node* old_root = root.get();
         FixRootOverflow();
+        ++version_;
+        hint.version_ = version_;
+        // nodes above the last split are untouched, keep them and descend again
+        hint.path_.resize(root.get() == old_root ? level + 1 : 0);
+        Locate(hint, key);
+        Seek(hint, key);
+    }
+    bool Find(const T& key) {
+        PROFILE_OP(TreeOp::kFind);
+        return Probe(key) == KeyState::kLive;
+    }
+    // Find as a coroutine suspending at every node, see FindInterleaved
+    FindTask FindAsync(T key) {
+        if (FilterRejects(key)) {
+            co_return false;
+        }
+        if (root == nullptr) {
+            co_return FlatContains(key);
+        }
+        Node* node = root.get();
+        int start = height_;
+        if (const auto* hot = HotTop()) {
+            std::size_t rank = hot->Rank(key);
+            if (!hot->IsSeparator(rank, key)) {
+                node = hot->EntryAt(rank);
+                start -= hot->Levels();
+            } else if (Tombstones() == 0) {
+                co_return true;
+            }
+        }
+        for (int height = start; node != nullptr; --height) {
+            co_await Prefetch{node};
+            if constexpr (std::is_reference_v<decltype(node->keys[0])>) {
+                if (!node->keys.empty()) {
+                    co_await Prefetch{&node->keys[0], height > 0 ? Internal(node)->childs.data() : nullptr};
+                }
+            }
+            std::size_t child_idx = FindChildIdx(node, key);
+            if (child_idx < node->KeysQuantity() && node->keys.KeyEquals(child_idx, key)) {
+                co_return !node->marks.Test(child_idx);
+            }
+            node = height == 0 ? nullptr : Internal(node)->childs[child_idx].get();
+        }
+        co_return false;
+    }
+    // The stored key equal to key, null if there is none. Members that take
+    // no part in the comparisons may be changed through it (see Counted).
+    const T* Lookup(const T& key) {
+        static_assert(std::is_reference_v<decltype(std::declval<const Keys&>()[0])>,
+                      "decoding storages hold no key to point to");
+        if (root == nullptr) {
+            std::size_t idx = FlatLowerBound(key);
+            return idx < flat_.size() && flat_[idx] == key ? &flat_[idx] : nullptr;
+        }
+        Node* node = root.get();
+        for (int height = height_;; --height) {
+            std::size_t idx = FindChildIdx(node, key);
+            if (idx < node->KeysQuantity() && node->keys.KeyEquals(idx, key)) {
+                return node->marks.Test(idx) ? nullptr : &node->keys[idx];
+            }
+            if (height == 0) {
+                return nullptr;
+            }
+            node = Internal(node)->childs[idx].get();
+        }
+    }
+    // Lookup starting from the deepest node of hint whose range covers key,
+    // then leave hint where the search ended: a following Insert(hint, key)
+    // of a missing key starts at its leaf.
+    const T* Lookup(Cursor& hint, const T& key) {
+        if (root == nullptr) {
+            return Lookup(key);
+        }
+        Locate(hint, key);
+        if (!Seek(hint, key) || MarkedAt(hint)) {
+            return nullptr;
+        }
+        const auto& level = hint.path_.back();
+        return &level.node->keys[level.child_idx];
     }
-    bool Find(T key) {
+    // Call visit on every live key in [lo, hi] in order, skipping the
+    // subtrees that lie outside.
+    template <typename Visit>
+    void ForEachInRange(const T& lo, const T& hi, Visit&& visit) {
+        if (hi < lo) {
+            return;
+        }
         if (root == nullptr) {
+            for (std::size_t idx = FlatLowerBound(lo); idx < flat_.size() && !(hi < flat_[idx]); ++idx) {
+                visit(flat_[idx]);
+            }
+            return;
+        }
+        VisitRange(root.get(), height_, lo, hi, visit);
+    }
+    // Find starting from the deepest node of hint whose range covers key,
+    // then leave hint on the node where the search ended.
+    bool Find(Cursor& hint, const T& key) {
+        PROFILE_OP(TreeOp::kFind);
+        if (FilterRejects(key)) {
             return false;
         }
-        return RecursiveFind(root.get(), key);
+        if (root == nullptr) {
+            return FlatContains(key);
+        }
+        Locate(hint, key);
+        return Seek(hint, key) && !MarkedAt(hint);
     }
-    void Delete(T key) {
-        LOG_DEBUG("Attempt to delete key: " << key);
-        if (!Find(key)) {
+    void Delete(const T& key) {
+        PROFILE_OP(TreeOp::kDelete);
+        if (Lazy() && root != nullptr) {
+            PROFILE_DESCENT(0);
+            Mark(root.get(), key, height_, true);
             return;
         }
-        LOG_DEBUG("Key=" << key << " found");
-        RecursiveDelete(root.get(), key);
-        LOG_DEBUG("End of RecursiveDelete");
-
-        if (root.get()->KeysQuantity() == 0) {
-            if (root.get()->childs.size() == 0) {
-                root = nullptr;
-            } else {
-                root = std::move(root.get()->childs[0]);
+        Erase(key);
+    }
+    // Lazy deletes only set a bit next to the key in its node, a lookup's
+    // worth of work: no key moves, no rebalancing. Lookups, range walks,
+    // aggregates and pops skip marked keys, and inserting the key again
+    // revives it. A leaf about to split drops its marked keys instead, and
+    // once marked keys exceed max_density of the stored ones, a delete also
+    // drops those of the leaf it lands in as far as the leaf can spare them.
+    // The rest waits for Compact(), which removes them with the rebalancing
+    // it takes. Flat trees delete right away.
+    void EnableLazyDelete(double max_density = 0.25) {
+        static_assert(std::is_copy_constructible_v<T>, "Compact erases copies of the marked keys");
+        Ext().lazy.emplace().max_density = max_density;
+    }
+    void DisableLazyDelete() {
+        Compact();
+        if (extras_) {
+            extras_->lazy.reset();
+        }
+    }
+    void Compact() {
+        if (Tombstones() > 0) {
+            std::vector<T> marked;
+            CollectMarked(root.get(), height_, marked);
+            for (const T& key : marked) {
+                Erase(key);
             }
         }
-        FixRootOverflow();
+        if (Filter() && Filter()->Stats().stale > 0) {
+            RebuildFilter();
+        }
+    }
+    std::size_t Tombstones() const {
+        return Lazy() ? Lazy()->marked : 0;
+    }
+    // Free every node without recursion: the unique_ptr chain would free the
+    // tree depth-first on the call stack.
+    void Clear() {
+        Teardown(std::move(root), height_);
+        height_ = 0;
+        flat_ = decltype(flat_)();
+        if (Lazy()) {
+            Lazy()->marked = 0;
+        }
+        if (Filter()) {
+            Filter()->Reset(0);
+        }
+        TouchTop(height_);
+        DropEdges();
+        size_ = 0;
+        ++version_;
+    }
+    // Clear in O(1), the nodes are freed on the AsyncDrop thread. A rebuilt
+    // tree is swapped in without a stall by tree.ClearAsync(); tree = std::move(rebuilt);
+    void ClearAsync() {
+        if (root) {
+            AsyncDrop::Drop(std::make_unique<DroppedNodes>(std::move(root), height_));
+        }
+        height_ = 0;
+        flat_ = decltype(flat_)();
+        if (Lazy()) {
+            Lazy()->marked = 0;
+        }
+        if (Filter()) {
+            Filter()->Reset(0);
+        }
+        TouchTop(height_);
+        DropEdges();
+        size_ = 0;
+        ++version_;
+    }
+    // Keep up to limit keys in one sorted array instead of nodes: one allocation,
+    // searched by branchless binary search. The nodes are built when an insert
+    // would exceed limit, and dropped again once deletes bring the tree down to
+    // limit / 2. 0 (the default) always uses nodes.
+    void SetFlatLimit(std::size_t limit) {
+        flat_limit_ = limit;
+        if (flat_.size() > flat_limit_) {
+            Materialize();
+        }
+        Flatten();
+    }
+    std::size_t FlatLimit() const {
+        return flat_limit_;
+    }
+    bool IsFlat() const {
+        return root == nullptr && !flat_.empty();
+    }
+    // Answer most misses from a blocked Bloom filter without walking the tree,
+    // at about fpr false positives and within max_bytes (0: no cap). Deletes
+    // leave stale bits behind, the filter is rebuilt from the keys once they
+    // pile up, when it is outgrown, and on Compact().
+    void EnableLookupFilter(double fpr = 0.01, std::size_t max_bytes = 0) {
+        static_assert(Hashable<T>, "the filter hashes keys with std::hash");
+        Ext().filter = std::make_unique<LookupFilter<T>>(fpr, max_bytes);
+        RebuildFilter();
+    }
+    void DisableLookupFilter() {
+        if (extras_) {
+            extras_->filter = nullptr;
+        }
+    }
+    FilterStats LookupFilterStats() const {
+        return Filter() ? Filter()->Stats() : FilterStats();
+    }
+    // Mirror the top levels of the tree in a HotIndex, so lookups start with
+    // a search of a few contiguous cache lines and land on a node levels
+    // below the root. Splits, merges and rotations in those levels mark the
+    // copy stale and the next lookup rebuilds it. Inserts and deletes still
+    // walk the nodes, they change them on the way back up; the lookup they
+    // begin with uses the index. Levels are only skipped in trees deeper
+    // than levels.
+    void EnableHotIndex(int levels = 2) {
+        static_assert(std::is_copy_constructible_v<T>, "the index holds copies of the separators");
+        Ext().hot = std::make_unique<HotIndex<T, Node*>>(std::max(levels, 1));
+    }
+    void DisableHotIndex() {
+        if (extras_) {
+            extras_->hot = nullptr;
+        }
+    }
+    std::size_t HotIndexBytes() const {
+        return Hot() ? Hot()->Bytes() : 0;
+    }
+    // Smallest and largest live key, null in an empty tree. With the pops
+    // below the tree serves as a priority queue: they take keys from cached
+    // edge leaves and only descend when a leaf runs short. Lazily deleted keys
+    // are skipped, the pops remove those they pass.
+    const T* Min() {
+        return Edge(false);
+    }
+    const T* Max() {
+        return Edge(true);
+    }
+    std::optional<T> PopMin() {
+        PROFILE_OP(TreeOp::kDelete);
+        return PopLive(false);
+    }
+    std::optional<T> PopMax() {
+        PROFILE_OP(TreeOp::kDelete);
+        return PopLive(true);
+    }
+    // the up to count smallest keys, removed, in order; the tree is fixed up
+    // once per leaf they come from rather than once per key
+    std::vector<T> PopMinBatch(std::size_t count) {
+        PROFILE_OP(TreeOp::kDelete);
+        std::vector<T> keys;
+        keys.reserve(std::min(count, Size()));
+        while (keys.size() < count && Size() > 0) {
+            PopMinRun(count - keys.size(), keys);
+        }
+        return keys;
+    }
+    // Combination by Augment of the keys in [lo, hi], in key order. Whole
+    // subtrees are taken from their cached aggregates, so it visits O(log n)
+    // nodes. Lazily deleted keys are left out of the cached aggregates.
+    typename Augment::Value Aggregate(const T& lo, const T& hi) {
+        static_assert(kAugmented, "Aggregate needs an Augment parameter");
+        typename Augment::Value value = Augment::Identity();
+        if (hi < lo) {
+            return value;
+        }
+        if (root == nullptr) {
+            for (std::size_t idx = FlatLowerBound(lo); idx < flat_.size() && !(hi < flat_[idx]); ++idx) {
+                value = Augment::Combine(value, Augment::Of(flat_[idx]));
+            }
+            return value;
+        }
+        return AggregateRange(root.get(), height_, lo, hi, false, false);
+    }
+    // live keys
+    std::size_t Size() const {
+        return size_ - Tombstones();
     }
     // void PrintTree() const {
     //     if (!root) {
@@ -150,6 +673,15 @@ public:
     //     PrintTreeRecursive(root.get(), 0);
     // }
         void PrintTreeLevels() const {
+        if (!root && !flat_.empty()) {
+            std::cout << "Flat: [";
+            for (size_t i = 0; i < flat_.size(); ++i) {
+                if (i > 0) std::cout << ", ";
+                std::cout << flat_[i];
+            }
+            std::cout << "]" << std::endl;
+            return;
+        }
         if (!root) {
             std::cout << "(empty tree)" << std::endl;
             return;
@@ -172,8 +704,10 @@ public:
                 std::cout << "]  ";
 
                 // Collect children for next level
-                for (const auto& child : node->childs) {
-                    if (child) next_level.push_back(child.get());
+                if (level < height_) {
+                    for (const auto& child : static_cast<const InternalNode*>(node)->childs) {
+                        next_level.push_back(child.get());
+                    }
                 }
             }
             std::cout << std::endl;
@@ -183,209 +717,924 @@ public:
         }
     }
 private:
-    std::size_t FindChildIdx(Node* node, T key) {
-        std::size_t child_idx = 0;
-        while (child_idx < node->KeysQuantity() && key > node->keys[child_idx]) {
-            ++child_idx;
+    struct DroppedNodes : Garbage {
+        NodePtr root;
+        int height;
+        DroppedNodes(NodePtr nodes, int nodes_height) : root(std::move(nodes)), height(nodes_height) {}
+        ~DroppedNodes() override {
+            Teardown(std::move(root), height);
+        }
+    };
+
+    static InternalNode* Internal(Node* node) {
+        return static_cast<InternalNode*>(node);
+    }
+    static NodePtr NewInternal() {
+        return NodePtr(new InternalNode());
+    }
+    static void Teardown(NodePtr node, int height) {
+        std::vector<std::pair<NodePtr, int>> pending;
+        if (node) {
+            pending.emplace_back(std::move(node), height);
+        }
+        while (!pending.empty()) {
+            // children are moved out first, so each node is freed alone
+            auto [last, last_height] = std::move(pending.back());
+            pending.pop_back();
+            if (last_height > 0) {
+                for (auto& child : Internal(last.get())->childs) {
+                    pending.emplace_back(std::move(child), last_height - 1);
+                }
+            }
+        }
+    }
+    // whether key is stored, and marked deleted, in one descent
+    KeyState Probe(const T& key) {
+        if (FilterRejects(key)) {
+            return KeyState::kAbsent;
+        }
+        if (root == nullptr) {
+            return FlatContains(key) ? KeyState::kLive : KeyState::kAbsent;
         }
-        return child_idx;
+        if (const auto* hot = HotTop()) {
+            std::size_t rank = hot->Rank(key);
+            if (!hot->IsSeparator(rank, key)) {
+                PROFILE_DESCENT(hot->Levels());
+                return RecursiveFind(hot->EntryAt(rank), key, height_ - hot->Levels());
+            }
+            if (Tombstones() == 0) {
+                return KeyState::kLive;
+            }
+            // the index copies no marks, the separator's node has it
+        }
+        PROFILE_DESCENT(0);
+        return RecursiveFind(root.get(), key, height_);
     }
-    void RecursiveInsert(Node* node, T key) {
-        if (node->IsLeaf()) {
-            node->InsertKey(key);
+    // the hot index when its entries are internal nodes, so leaf splits and
+    // merges leave it valid; rebuilt if stale
+    const HotIndex<T, Node*>* HotTop() {
+        if constexpr (std::is_copy_constructible_v<T>) {
+            HotIndex<T, Node*>* hot = Hot();
+            if (!hot || root == nullptr || height_ <= hot->Levels()) {
+                return nullptr;
+            }
+            if (!hot->Valid()) {
+                std::vector<T> separators;
+                std::vector<Node*> entries;
+                CollectTop(root.get(), height_, separators, entries);
+                hot->Assign(std::move(separators), std::move(entries));
+            }
+            return hot;
         } else {
-            std::size_t child_idx = FindChildIdx(node, key);
-            RecursiveInsert(node->childs[child_idx].get(), key);
-            SplitChild(node, child_idx);
+            return nullptr;
+        }
+    }
+    void CollectTop(Node* node, int height, std::vector<T>& separators, std::vector<Node*>& entries) {
+        if (height_ - height == Hot()->Levels()) {
+            entries.push_back(node);
+            return;
+        }
+        for (std::size_t i = 0; i < node->KeysQuantity(); ++i) {
+            CollectTop(Internal(node)->childs[i].get(), height - 1, separators, entries);
+            separators.push_back(node->keys[i]);
+        }
+        CollectTop(Internal(node)->childs.back().get(), height - 1, separators, entries);
+    }
+    // the keys or children of a node at height are about to change
+    void TouchTop(int height) {
+        if (HotIndex<T, Node*>* hot = Hot(); hot && height_ - height < hot->Levels()) {
+            hot->Invalidate();
         }
     }
-    void SplitChild(Node* node, size_t child_idx) {
-        if (node->childs.size() > child_idx) {
-            LOG_DEBUG("SRT_SPLITING: " << *node << " with child(" << child_idx << "): " << *(node->childs[child_idx].get()));
+    Extras& Ext() {
+        if (!extras_) {
+            extras_ = std::make_unique<Extras>();
+        }
+        return *extras_;
+    }
+    LazyDeletes* Lazy() const {
+        return extras_ && extras_->lazy ? &*extras_->lazy : nullptr;
+    }
+    LookupFilter<T>* Filter() const {
+        return extras_ ? extras_->filter.get() : nullptr;
+    }
+    HotIndex<T, Node*>* Hot() const {
+        return extras_ ? extras_->hot.get() : nullptr;
+    }
+    bool FilterRejects(const T& key) const {
+        if constexpr (Hashable<T>) {
+            return Filter() && !Filter()->MayContain(key);
         } else {
-            LOG_DEBUG("SRT_SPLITING: " << *node << " without childs");
+            return false;
+        }
+    }
+    void FilterAdd(const T& key) {
+        if constexpr (Hashable<T>) {
+            if (Filter() && Filter()->Add(key)) {
+                // key is not stored yet, so the rebuild misses it
+                RebuildFilter();
+                Filter()->Add(key);
+            }
+        }
+    }
+    void RebuildFilter() {
+        if constexpr (Hashable<T>) {
+            LookupFilter<T>* filter = Filter();
+            filter->Reset(size_);
+            for (const T& key : flat_) {
+                filter->Add(key);
+            }
+            if (root != nullptr) {
+                std::vector<std::pair<const Node*, int>> pending = {{root.get(), height_}};
+                while (!pending.empty()) {
+                    auto [node, height] = pending.back();
+                    pending.pop_back();
+                    for (const auto& key : node->keys) {
+                        filter->Add(key);
+                    }
+                    if (height > 0) {
+                        for (const auto& child : static_cast<const InternalNode*>(node)->childs) {
+                            pending.emplace_back(child.get(), height - 1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    // false once a key past hi is reached
+    template <typename Visit>
+    bool VisitRange(Node* node, int height, const T& lo, const T& hi, Visit& visit) {
+        for (std::size_t idx = node->LowerBound(lo); idx <= node->KeysQuantity(); ++idx) {
+            if (height > 0 && !VisitRange(Internal(node)->childs[idx].get(), height - 1, lo, hi, visit)) {
+                return false;
+            }
+            if (idx == node->KeysQuantity()) {
+                break;
+            }
+            if (hi < node->keys[idx]) {
+                return false;
+            }
+            if (!node->marks.Test(idx)) {
+                visit(node->keys[idx]);
+            }
+        }
+        return true;
+    }
+    bool MarkedAt(const Cursor& hint) const {
+        const auto& level = hint.path_.back();
+        return level.node->marks.Test(level.child_idx);
+    }
+    // Set or clear the mark of the key of node's subtree equal to key and
+    // redo the aggregates above it; false if there was nothing to change. A
+    // leaf past the density threshold drops the marked keys it can spare.
+    bool Mark(Node* node, const T& key, int height, bool marked) {
+        std::size_t idx = FindChildIdx(node, key);
+        if (idx < node->KeysQuantity() && node->keys.KeyEquals(idx, key)) {
+            if (node->marks.Test(idx) == marked) {
+                return false;
+            }
+            node->marks.Set(idx, marked);
+            if (marked) {
+                ++Lazy()->marked;
+                if (height == 0 && Tombstones() > Lazy()->max_density * size_) {
+                    Purge(node, height_ == 0 ? 1 : MinKeys(0));
+                }
+            } else {
+                --Lazy()->marked;
+            }
+        } else if (height == 0 || !Mark(Internal(node)->childs[idx].get(), key, height - 1, marked)) {
+            return false;
+        }
+        Reaggregate(node, height);
+        return true;
+    }
+    void Revive(const T& key) {
+        Mark(root.get(), key, height_, false);
+    }
+    // clear the mark of the key hint stops on
+    void Revive(Cursor& hint) {
+        auto& level = hint.path_.back();
+        if (!level.node->marks.Test(level.child_idx)) {
             return;
         }
-        // PrintTreeLevels();
-        
-        auto& child_ptr = node->childs[child_idx];
-        Node* child_raw = child_ptr.get(); 
-
-        if (child_raw->KeysQuantity() < Order) {
+        level.node->marks.Set(level.child_idx, false);
+        --Lazy()->marked;
+        for (std::size_t i = hint.path_.size(); i-- > 0;) {
+            Reaggregate(hint.path_[i].node, height_ - static_cast<int>(i));
+        }
+    }
+    // Remove the marked keys of a leaf while it holds more than floor keys.
+    // No other node changes, and the leaf's aggregate left them out already.
+    void Purge(Node* leaf, std::size_t floor) {
+        bool purged = false;
+        for (std::size_t idx = leaf->KeysQuantity(); idx-- > 0 && leaf->KeysQuantity() > floor;) {
+            if (leaf->marks.Test(idx)) {
+                bool marked = false;
+                leaf->TakeKey(idx, marked);
+                --size_;
+                --Lazy()->marked;
+                purged = true;
+                if (Filter() && Filter()->Remove()) {
+                    RebuildFilter();
+                }
+            }
+        }
+        if (purged) {
+            ++version_;
+            TouchTop(0);
+            leaf->Refit();
+        }
+    }
+    // copies of the marked keys of node's subtree
+    void CollectMarked(Node* node, int height, std::vector<T>& out) const {
+        node->marks.ForEach([node, &out](std::size_t idx) {
+            out.push_back(node->keys[idx]);
+        });
+        if (height > 0) {
+            for (const auto& child : Internal(node)->childs) {
+                CollectMarked(child.get(), height - 1, out);
+            }
+        }
+    }
+    void Erase(const T& key) {
+        KeyState state = Probe(key);
+        if (state == KeyState::kAbsent) {
             return;
         }
+        if (state == KeyState::kMarked) {
+            --Lazy()->marked;
+        }
+        ++version_;
+        --size_;
+        if (Filter() && Filter()->Remove()) {
+            // the key is still in the nodes, which is harmless
+            RebuildFilter();
+        }
+        if (root == nullptr) {
+            flat_.erase(flat_.begin() + FlatLowerBound(key));
+            return;
+        }
+        PROFILE_DESCENT(0);
+        RecursiveDelete(root.get(), key, height_);
+        CollapseRoot();
+        FixRootOverflow();
+        Flatten();
+    }
+    const T* Edge(bool largest) {
+        static_assert(std::is_reference_v<decltype(std::declval<const Keys&>()[0])>,
+                      "decoding storages hold no key to point to");
+        if (Size() == 0) {
+            return nullptr;
+        }
+        if (root == nullptr) {
+            return largest ? &flat_.back() : &flat_.front();
+        }
+        Node* leaf = EdgeLeaf(largest);
+        std::size_t quantity = leaf->KeysQuantity();
+        for (std::size_t i = 0; i < quantity; ++i) {
+            std::size_t idx = largest ? quantity - 1 - i : i;
+            if (!leaf->marks.Test(idx)) {
+                return &leaf->keys[idx];
+            }
+        }
+        // every key of the edge leaf is marked
+        return FirstLive(root.get(), height_, largest);
+    }
+    // the first live key of node's subtree in key order, or in reverse order if largest
+    const T* FirstLive(Node* node, int height, bool largest) {
+        std::size_t quantity = node->KeysQuantity();
+        for (std::size_t i = 0; i <= quantity; ++i) {
+            if (height > 0) {
+                if (const T* key = FirstLive(Internal(node)->childs[largest ? quantity - i : i].get(), height - 1, largest)) {
+                    return key;
+                }
+            }
+            std::size_t idx = largest ? quantity - 1 - i : i;
+            if (i < quantity && !node->marks.Test(idx)) {
+                return &node->keys[idx];
+            }
+        }
+        return nullptr;
+    }
+    // PopEdge until it yields a live key, the marked keys on the way are dropped
+    std::optional<T> PopLive(bool largest) {
+        if (Size() == 0) {
+            return std::nullopt;
+        }
+        while (true) {
+            bool marked = false;
+            T key = PopEdge(largest, marked);
+            if (!marked) {
+                return key;
+            }
+        }
+    }
+    // drop a root left without keys
+    void CollapseRoot() {
+        if (root->KeysQuantity() == 0) {
+            DropEdges();
+            if (height_ == 0) {
+                root = nullptr;
+            } else {
+                root = std::move(Internal(root.get())->childs[0]);
+                --height_;
+            }
+        }
+    }
+    void DropEdges() {
+        if (extras_) {
+            extras_->min_leaf = nullptr;
+            extras_->max_leaf = nullptr;
+        }
+    }
+    Node* EdgeLeaf(bool largest) {
+        Node*& leaf = largest ? Ext().max_leaf : Ext().min_leaf;
+        if (leaf == nullptr) {
+            leaf = largest ? FindMaximalLeaf(root.get(), height_) : FindMinimalLeaf(root.get(), height_);
+        }
+        return leaf;
+    }
+    // Move up to count (> 0) smallest keys of a non-empty tree to out. The
+    // keys the minimal leaf can spare leave it in one go, then PopEdge takes
+    // one more and does the fix-up the leaf needs.
+    void PopMinRun(std::size_t count, std::vector<T>& out) {
+        std::size_t run = 0;
+        if (root == nullptr) {
+            run = std::min(count, flat_.size());
+            out.insert(out.end(), std::make_move_iterator(flat_.begin()), std::make_move_iterator(flat_.begin() + run));
+            flat_.erase(flat_.begin(), flat_.begin() + run);
+        } else {
+            Node* leaf = EdgeLeaf(false);
+            std::size_t floor = height_ == 0 ? 1 : MinKeys(0);
+            std::size_t spare = leaf->KeysQuantity() > floor ? leaf->KeysQuantity() - floor : 0;
+            run = std::min(count - 1, spare);
+            if (leaf->marks.Any()) {
+                std::vector<T> taken;
+                leaf->keys.ExtractFront(run, taken);
+                for (std::size_t i = 0; i < run; ++i) {
+                    if (leaf->marks.Test(i)) {
+                        --Lazy()->marked;
+                    } else {
+                        out.push_back(std::move(taken[i]));
+                    }
+                }
+                leaf->marks.EraseFront(run);
+            } else {
+                leaf->keys.ExtractFront(run, out);
+            }
+            leaf->Refit();
+        }
+        ++version_;
+        size_ -= run;
+        if (Filter()) {
+            bool rebuild = false;
+            for (std::size_t i = 0; i < run; ++i) {
+                rebuild = Filter()->Remove() || rebuild;
+            }
+            if (rebuild) {
+                RebuildFilter();
+            }
+        }
+        if (root != nullptr) {
+            bool marked = false;
+            T key = PopEdge(false, marked);
+            if (!marked) {
+                out.push_back(std::move(key));
+            }
+        }
+    }
+    // Remove and return the smallest or largest key of a non-empty tree. It
+    // is taken straight from the cached edge leaf; only when that leaf falls
+    // below its minimum (or aggregates need updating) is the edge of the tree
+    // walked from the root, rebalancing on the way back up like RecursiveDelete.
+    // marked tells whether the key was deleted lazily.
+    T PopEdge(bool largest, bool& marked) {
+        marked = false;
+        ++version_;
+        --size_;
+        if (Filter() && Filter()->Remove()) {
+            RebuildFilter();
+        }
+        if (root == nullptr) {
+            auto pos = largest ? flat_.end() - 1 : flat_.begin();
+            T key = std::move(*pos);
+            flat_.erase(pos);
+            return key;
+        }
+        Node* leaf = EdgeLeaf(largest);
+        T key = leaf->TakeKey(largest ? leaf->KeysQuantity() - 1 : 0, marked);
+        if (marked) {
+            --Lazy()->marked;
+        }
+        leaf->Refit();
+        if (height_ == 0) {
+            Reaggregate(leaf, 0);
+            CollapseRoot();
+        } else if (leaf->KeysQuantity() >= MinKeys(0)) {
+            // only the aggregates along the edge can change
+            ReaggregateEdge(root.get(), height_, largest);
+        } else {
+            Reaggregate(leaf, 0);
+            std::vector<InternalNode*> spine;
+            Node* node = root.get();
+            for (int height = height_; height > 0; --height) {
+                spine.push_back(Internal(node));
+                node = largest ? spine.back()->childs.back().get() : spine.back()->childs.front().get();
+            }
+            for (std::size_t i = spine.size(); i-- > 0;) {
+                int height = height_ - static_cast<int>(i);
+                std::size_t child_idx = largest ? spine[i]->childs.size() - 1 : 0;
+                std::size_t neighbour_idx = largest ? child_idx - 1 : child_idx + 1;
+                Node* child = spine[i]->childs[child_idx].get();
+                Node* neighbour = spine[i]->childs[neighbour_idx].get();
+                if (child->KeysQuantity() < MinKeys(height - 1)) {
+                    // take half of the neighbour's surplus rather than the one key
+                    // MergeChild would, so the next pops stay in the cached leaf
+                    TouchTop(height);
+                    while (CanSpare(neighbour, height - 1) && neighbour->KeysQuantity() > child->KeysQuantity() + 1) {
+                        RotateKey(spine[i], neighbour_idx, child_idx, height);
+                    }
+                }
+                MergeChild(spine[i], child_idx, height);
+                SplitChild(spine[i], child_idx, height);
+                Reaggregate(spine[i], height);
+            }
+            CollapseRoot();
+            FixRootOverflow();
+        }
+        Flatten();
+        return key;
+    }
+    // index of the first flat key not less than key; the loop halves the range
+    // with a conditional move instead of a branch
+    std::size_t FlatLowerBound(const T& key) const {
+        std::size_t n = flat_.size();
+        if (n == 0) {
+            return 0;
+        }
+        const T* base = flat_.data();
+        while (n > 1) {
+            std::size_t half = n / 2;
+            base = (base[half] < key) ? base + half : base;
+            n -= half;
+        }
+        return static_cast<std::size_t>(base - flat_.data()) + (*base < key);
+    }
+    bool FlatContains(const T& key) {
+        PROFILE_DESCENT(0);
+        PROFILE_NODE();
+        PROFILE_COMPARISONS(std::bit_width(flat_.size()));
+        std::size_t idx = FlatLowerBound(key);
+        return idx < flat_.size() && flat_[idx] == key;
+    }
+    void InsertIntoNodes(T key) {
+        if (root == nullptr) {
+            root = NodePtr(new Node(std::move(key)));
+            Reaggregate(root.get(), 0);
+            return;
+        }
+        PROFILE_DESCENT(0);
+        RecursiveInsert(root.get(), std::move(key), height_);
+        FixRootOverflow();
+    }
+    // move the flat keys into nodes
+    void Materialize() {
+        if (flat_.empty()) {
+            return;
+        }
+        // cursors and the hot index hold no nodes of a flat tree, but may of an earlier one
+        ++version_;
+        TouchTop(height_);
+        auto keys = std::move(flat_);
+        flat_ = decltype(flat_)();
+        for (T& key : keys) {
+            InsertIntoNodes(std::move(key));
+        }
+    }
+    // move the keys of a tree shrunk to half the flat limit back into the array
+    void Flatten() {
+        if (root == nullptr || size_ > flat_limit_ / 2) {
+            return;
+        }
+        ++version_;
+        TouchTop(height_);
+        DropEdges();
+        flat_.reserve(flat_limit_);
+        AppendKeys(root.get(), height_);
+        Teardown(std::move(root), height_);
+        height_ = 0;
+    }
+    // in order, moving the keys out of the nodes
+    void AppendKeys(Node* node, int height) {
+        std::size_t quantity = node->KeysQuantity();
+        for (std::size_t i = 0; i < quantity; ++i) {
+            if (height > 0) {
+                AppendKeys(Internal(node)->childs[i].get(), height - 1);
+            }
+            bool marked = false;
+            T key = node->TakeKey(0, marked);
+            if (marked) {
+                --size_;
+                --Lazy()->marked;
+            } else {
+                flat_.push_back(std::move(key));
+            }
+        }
+        if (height > 0) {
+            AppendKeys(Internal(node)->childs.back().get(), height - 1);
+        }
+    }
+    // drop the levels of hint whose range does not cover key, restart stale hints at root
+    void Locate(Cursor& hint, const T& key) {
+        if (hint.version_ != version_ || hint.path_.empty()) {
+            hint.version_ = version_;
+            hint.path_.clear();
+            hint.path_.push_back({root.get(), std::nullopt, std::nullopt, 0});
+        }
+        while (hint.path_.size() > 1) {
+            const auto& level = hint.path_.back();
+            if ((!level.low || *level.low < key) && (!level.high || key < *level.high)) {
+                break;
+            }
+            hint.path_.pop_back();
+        }
+    }
+    // descend from the last level of hint towards key, recording the path
+    bool Seek(Cursor& hint, const T& key) {
+        PROFILE_DESCENT(static_cast<int>(hint.path_.size()) - 1);
+        while (true) {
+            auto& level = hint.path_.back();
+            Node* node = level.node;
+            std::size_t idx = FindChildIdx(node, key);
+            level.child_idx = idx;
+            if (idx < node->KeysQuantity() && node->keys.KeyEquals(idx, key)) {
+                return true;
+            }
+            if (hint.path_.size() > static_cast<std::size_t>(height_)) {
+                return false;
+            }
+            std::optional<T> low = idx > 0 ? std::optional<T>(node->keys[idx - 1]) : level.low;
+            std::optional<T> high = idx < node->KeysQuantity() ? std::optional<T>(node->keys[idx]) : level.high;
+            hint.path_.push_back({Internal(node)->childs[idx].get(), std::move(low), std::move(high), 0});
+        }
+    }
+    int NodeOrder(int height) const {
+        return height == 0 ? LeafOrder() : InternalOrder();
+    }
+    std::size_t MinKeys(int height) const {
+        return (NodeOrder(height) + 1) / 2 - 1;
+    }
+    std::size_t FindChildIdx(Node* node, const T& key) {
+        PROFILE_NODE();
+        std::size_t idx = node->LowerBound(key);
+        PROFILE_COMPARISONS(Search::Comparisons(node->route, node->KeysQuantity()));
+        return idx;
+    }
+    // height is the height of node in every helper below, its children are one lower
+    void RecursiveInsert(Node* node, T&& key, int height) {
+        if (height == 0) {
+            PROFILE_NODE();
+            node->InsertKey(std::move(key));
+        } else {
+            std::size_t child_idx = FindChildIdx(node, key);
+            RecursiveInsert(Internal(node)->childs[child_idx].get(), std::move(key), height - 1);
+            SplitChild(Internal(node), child_idx, height);
+        }
+        Reaggregate(node, height);
+    }
+    bool SplitChild(InternalNode* node, size_t child_idx, int height) {
+        if (node->childs.size() <= child_idx) {
+            return false;
+        }
+        Node* child_raw = node->childs[child_idx].get();
 
-        T mid_key = child_raw->keys[child_raw->KeysQuantity() / 2];
-        node->InsertKey(mid_key);
-
-        auto left = std::make_unique<Node>();
-        for (size_t i = 0; i < child_raw->KeysQuantity() / 2; ++i) {
-            left->InsertKey(child_raw->keys[i]);
+        std::size_t order = NodeOrder(height - 1);
+        if (child_raw->KeysQuantity() < order) {
+            return false;
         }
-        auto right = std::make_unique<Node>();
-        for (size_t i = child_raw->KeysQuantity() / 2 + 1; i < child_raw->KeysQuantity(); ++i) {
-            right->InsertKey(child_raw->keys[i]);
+        if (height == 1 && child_raw->marks.Any()) {
+            // the slots of lazily deleted keys make room without a split
+            Purge(child_raw, MinKeys(0));
+            if (child_raw->KeysQuantity() < order) {
+                return false;
+            }
         }
-        if (!child_raw->IsLeaf()) {
-            for (size_t i = 0; i <= child_raw->KeysQuantity() / 2; ++i) {
-                left->AddChild(std::move(child_ptr->childs[i]));
+        TouchTop(height);
+
+        // one key too many: hand it to a sibling with room, or split together
+        // with a full sibling into three nodes (B*-tree)
+        if (child_raw->KeysQuantity() == order && node->childs.size() > 1) {
+            if (child_idx > 0 && HasRoom(node->childs[child_idx - 1].get(), height - 1)) {
+                RotateKey(node, child_idx, child_idx - 1, height);
+                return true;
             }
-            for (size_t i = child_raw->KeysQuantity() / 2 + 1; i <= child_raw->KeysQuantity(); ++i) {
-                right->AddChild(std::move(child_ptr->childs[i]));
+            if (child_idx + 1 < node->childs.size() && HasRoom(node->childs[child_idx + 1].get(), height - 1)) {
+                RotateKey(node, child_idx, child_idx + 1, height);
+                return true;
             }
+            SplitTwoToThree(node, child_idx + 1 < node->childs.size() ? child_idx : child_idx - 1, height);
+            return true;
         }
+        ++Ext().stats.splits;
+        DropEdges();
+
+        // any split point leaving both halves between the minimal and maximal size is legal
+        std::size_t quantity = child_raw->KeysQuantity();
+        std::size_t min_keys = MinKeys(height - 1);
+        std::size_t lo = std::max(min_keys, quantity > order ? quantity - order : 0);
+        std::size_t hi = std::min(order - 1, quantity - 1 - min_keys);
+        std::size_t mid = child_raw->keys.SeparatorIdx(lo, hi);
 
-        node->childs[child_idx] = std::move(left); 
+        // the child keeps the left half, the right half is moved out in bulk
+        NodePtr right = height > 1 ? NewInternal() : NodePtr(new Node());
+        bool mid_marked = false;
+        T mid_key = child_raw->SplitKeys(mid, *right, mid_marked);
+        if (height > 1) {
+            auto& childs = Internal(child_raw)->childs;
+            Internal(right.get())->childs.assign(
+                std::make_move_iterator(childs.begin() + mid + 1),
+                std::make_move_iterator(childs.end())
+            );
+            childs.erase(childs.begin() + mid + 1, childs.end());
+        }
+        child_raw->Refit();
+        right->Refit();
+        Reaggregate(child_raw, height - 1);
+        Reaggregate(right.get(), height - 1);
+        node->InsertKey(std::move(mid_key), mid_marked);
         node->childs.insert(
             node->childs.begin() + child_idx + 1,
             std::move(right)
         );
+        return true;
     }
-    bool RecursiveFind(Node* node, T key) {
-        if (node->HasKey(key)) {
-            return true;
+    KeyState RecursiveFind(Node* node, const T& key, int height) {
+        std::size_t child_idx = FindChildIdx(node, key);
+        if (child_idx < node->KeysQuantity() && node->keys.KeyEquals(child_idx, key)) {
+            return node->marks.Test(child_idx) ? KeyState::kMarked : KeyState::kLive;
         }
 
-        if (node->IsLeaf()) {
-            return false;
+        if (height == 0) {
+            return KeyState::kAbsent;
         }
 
-        std::size_t child_idx = FindChildIdx(node, key);
-        return RecursiveFind(node->childs[child_idx].get(), key);
+        return RecursiveFind(Internal(node)->childs[child_idx].get(), key, height - 1);
     }
-    void RecursiveDelete(Node* node, T key) {
-        // debug
-        if (!node->IsLeaf()) {
-            LOG_DEBUG("BEFORE:");
-            LOG_DEBUG("Parent: " << node << ' ' << *node);
-            LOG_DEBUG("Childs:");
-            for (size_t i = 0; i < node->childs.size(); ++i) {
-                LOG_DEBUG("    " << node->childs[i].get() << ' ' << *(node->childs[i].get()));
-            }
-            LOG_DEBUG("END_BEFORE");
-        }
-
+    void RecursiveDelete(Node* node, const T& key, int height) {
         size_t child_idx = FindChildIdx(node, key);
         if (node->HasKey(key)) {
-            if (node->IsLeaf()) {
-                LOG_DEBUG("Key=" << key << " deleted");
+            if (height == 0) {
                 node->DeleteKey(key);
+                Reaggregate(node, height);
                 return;
             } else {
-                T changing_key = 0;
-                Node* changing_key_subtree;
-                size_t key_idx = 0;
-                for (; key_idx < node->KeysQuantity() && node->keys[key_idx] != key; ++key_idx); 
-
-                
-                if (node->keys[0] == key) {
-                    child_idx = 0;
-                    changing_key = FindMaximalKey(node->childs[child_idx].get());
-                } else {
-                    child_idx = key_idx + 1;
-                    changing_key = FindMinimalKey(node->childs[child_idx].get());
-                }
-                
-                changing_key_subtree = node->childs[child_idx].get();
-                LOG_DEBUG("Take changing_key=" << changing_key << " from subtree(" << *changing_key_subtree << ")" << " child=" << child_idx);
-                
-                node->DeleteKey(key);
-                node->InsertKey(changing_key);
-                // child_idx = FindChildIdx(node, changing_key);
-                LOG_DEBUG("Take changin_key=" << changing_key << " from child(" << child_idx << ")");
-                RecursiveDelete(changing_key_subtree, changing_key);
+                size_t key_idx = child_idx;
+
+                // predecessor for the first key, successor for the others
+                child_idx = (key_idx == 0) ? 0 : key_idx + 1;
+                Node* changing_key_subtree = Internal(node)->childs[child_idx].get();
+                Node* leaf = (key_idx == 0)
+                    ? FindMaximalLeaf(changing_key_subtree, height - 1)
+                    : FindMinimalLeaf(changing_key_subtree, height - 1);
+                size_t leaf_idx = (key_idx == 0) ? leaf->KeysQuantity() - 1 : 0;
+
+                // swap the key with its neighbour in the leaf, nothing is copied,
+                // and delete it from there: the leaf stays sorted
+                TouchTop(height);
+                bool marked = false;
+                T changing_key = leaf->TakeKey(leaf_idx, marked);
+                T moved_key = node->SwapKey(key_idx, std::move(changing_key), marked);
+                leaf->InsertKey(std::move(moved_key), marked);
+                node->Refit();
+                RecursiveDelete(changing_key_subtree, key, height - 1);
             }
         } else {
-            RecursiveDelete(node->childs[child_idx].get(), key);
+            RecursiveDelete(Internal(node)->childs[child_idx].get(), key, height - 1);
+        }
+        if (height > 0) {
+            MergeChild(Internal(node), child_idx, height);
+            SplitChild(Internal(node), child_idx, height);
         }
-        if (!node->IsLeaf()) {
+        Reaggregate(node, height);
+    }
+    void MergeChild(InternalNode* node, size_t child_idx, int height) {
+        Node* child = node->childs[child_idx].get();
+        if (child->KeysQuantity() < MinKeys(height - 1)) {
+            TouchTop(height);
+            // borrow a key from a sibling that can spare one
+            if (child_idx > 0 && CanSpare(node->childs[child_idx - 1].get(), height - 1)) {
+                RotateKey(node, child_idx - 1, child_idx, height);
+                return;
+            }
+            if (child_idx + 1 < node->childs.size() && CanSpare(node->childs[child_idx + 1].get(), height - 1)) {
+                RotateKey(node, child_idx + 1, child_idx, height);
+                return;
+            }
+            ++Ext().stats.merges;
+            DropEdges();
+            size_t brother_idx = (child_idx == 0) ? child_idx + 1 : child_idx - 1;
+            size_t separator_idx = std::min(child_idx, brother_idx);
+            Node* brother = node->childs[brother_idx].get();
 
-            MergeChild(node, child_idx);
-            LOG_DEBUG("AFTER:\nParent: " << node << ' ' << *node);
-            LOG_DEBUG("Childs: ");
-            for (size_t i = 0; i < node->childs.size(); ++i) {
-                LOG_DEBUG("    " << node->childs[i].get() << ' ' << *(node->childs[i].get()));
+            // brother absorbs the separator, the remaining keys of child and its subtrees
+            bool marked = false;
+            T separator = node->TakeKey(separator_idx, marked);
+            brother->InsertKey(std::move(separator), marked);
+            brother->AbsorbKeys(*child, child_idx < brother_idx);
+            brother->Refit();
+            if (height > 1) {
+                auto& brother_childs = Internal(brother)->childs;
+                auto& child_childs = Internal(child)->childs;
+                brother_childs.insert(
+                    child_idx < brother_idx ? brother_childs.begin() : brother_childs.end(),
+                    std::make_move_iterator(child_childs.begin()),
+                    std::make_move_iterator(child_childs.end())
+                );
             }
-            LOG_DEBUG("END_AFTER");
-            SplitChild(node, child_idx);
+            Reaggregate(brother, height - 1);
+            node->DeleteChild(child_idx);
+            node->Refit();
+            if (child_idx < brother_idx) --brother_idx;
+            SplitChild(node, brother_idx, height);
         }
-        
     }
-    void MergeChild(Node* node, size_t child_idx) {
-        Node* child = node->childs[child_idx].get();
-        LOG_DEBUG("SRT_MERGING:");
-        LOG_DEBUG("Parent: " << node << ' ' << *node);
-        LOG_DEBUG("Child_idx: " << child_idx << " " << *child);
-        for (size_t i = 0; i < node->childs.size(); ++i) {
-            LOG_DEBUG("" << node->childs[i].get() << ' ' << *(node->childs[i].get()));
-        }
-        size_t brother_idx;
-        if (child_idx == 0) {
-            brother_idx = 0;
+    bool HasRoom(Node* node, int height) const {
+        return node->KeysQuantity() + 1 < static_cast<std::size_t>(NodeOrder(height));
+    }
+    bool CanSpare(Node* node, int height) const {
+        return node->KeysQuantity() > MinKeys(height);
+    }
+    // move one key from child from_idx to its adjacent sibling to_idx through the separator
+    void RotateKey(InternalNode* node, std::size_t from_idx, std::size_t to_idx, int height) {
+        Node* from = node->childs[from_idx].get();
+        Node* to = node->childs[to_idx].get();
+        std::size_t separator_idx = std::min(from_idx, to_idx);
+        if (from_idx < to_idx) {
+            bool marked = false;
+            T up = from->TakeKey(from->KeysQuantity() - 1, marked);
+            T down = node->SwapKey(separator_idx, std::move(up), marked);
+            to->InsertKey(std::move(down), marked);
+            from->Refit();
+            if (height > 1) {
+                auto& from_childs = Internal(from)->childs;
+                auto& to_childs = Internal(to)->childs;
+                to_childs.insert(to_childs.begin(), std::move(from_childs.back()));
+                from_childs.pop_back();
+            }
         } else {
-            brother_idx = child_idx - 1;
-        }
-        if (child->KeysQuantity() < (Order + 1) / 2 - 1) {
-            if (!child->IsLeaf()) {
-                Node* brother = nullptr;
-                if (child_idx == 0) {
-                    brother_idx = child_idx + 1;
-                    brother = node->childs[brother_idx].get();
-                    for (size_t i = 0; i < child->childs.size(); ++i) {
-                        brother->AddChild(brother->childs.begin() + i, std::move(child->childs[i]));
-                    }
-                } else {
-                    brother_idx = child_idx - 1;
-                    brother = node->childs[brother_idx].get();
-                    for (size_t i = 0; i < child->childs.size(); ++i) {
-                        brother->AddChild(brother->childs.end(), std::move(child->childs[i]));
-                    }
+            bool marked = false;
+            T up = from->TakeKey(0, marked);
+            T down = node->SwapKey(separator_idx, std::move(up), marked);
+            to->InsertKey(std::move(down), marked);
+            from->Refit();
+            if (height > 1) {
+                Internal(to)->childs.push_back(std::move(Internal(from)->childs.front()));
+                Internal(from)->DeleteChild(0);
+            }
+        }
+        node->Refit();
+        Reaggregate(from, height - 1);
+        Reaggregate(to, height - 1);
+        ++Ext().stats.rotations;
+    }
+    // children left_idx and left_idx + 1 with the separator between them are
+    // redistributed over three nodes
+    void SplitTwoToThree(InternalNode* node, std::size_t left_idx, int height) {
+        Node* left = node->childs[left_idx].get();
+        NodePtr right = std::move(node->childs[left_idx + 1]);
+        node->DeleteChild(left_idx + 1);
+        bool marked = false;
+        T separator = node->TakeKey(left_idx, marked);
+        left->InsertKey(std::move(separator), marked);
+        left->AbsorbKeys(*right, false);
+        if (height > 1) {
+            auto& right_childs = Internal(right.get())->childs;
+            Internal(left)->childs.insert(
+                Internal(left)->childs.end(),
+                std::make_move_iterator(right_childs.begin()),
+                std::make_move_iterator(right_childs.end())
+            );
+        }
+
+        std::size_t quantity = left->KeysQuantity();
+        std::size_t first = (quantity - 2) / 3;
+        std::size_t second = (quantity - 2 - first) / 2;
+        NodePtr third_node = height > 1 ? NewInternal() : NodePtr(new Node());
+        bool second_marked = false;
+        T second_separator = left->SplitKeys(first + second + 1, *third_node, second_marked);
+        NodePtr second_node = height > 1 ? NewInternal() : NodePtr(new Node());
+        bool first_marked = false;
+        T first_separator = left->SplitKeys(first, *second_node, first_marked);
+        if (height > 1) {
+            auto& childs = Internal(left)->childs;
+            Internal(third_node.get())->childs.assign(
+                std::make_move_iterator(childs.begin() + first + second + 2),
+                std::make_move_iterator(childs.end())
+            );
+            Internal(second_node.get())->childs.assign(
+                std::make_move_iterator(childs.begin() + first + 1),
+                std::make_move_iterator(childs.begin() + first + second + 2)
+            );
+            childs.erase(childs.begin() + first + 1, childs.end());
+        }
+        left->Refit();
+        second_node->Refit();
+        third_node->Refit();
+        Reaggregate(left, height - 1);
+        Reaggregate(second_node.get(), height - 1);
+        Reaggregate(third_node.get(), height - 1);
+        node->InsertKey(std::move(first_separator), first_marked);
+        node->InsertKey(std::move(second_separator), second_marked);
+        node->childs.insert(node->childs.begin() + left_idx + 1, std::move(second_node));
+        node->childs.insert(node->childs.begin() + left_idx + 2, std::move(third_node));
+        ++Ext().stats.splits;
+        DropEdges();
+    }
+    // recompute the aggregate of node from its keys and its children's aggregates
+    void Reaggregate(Node* node, int height) {
+        if constexpr (kAugmented) {
+            typename Augment::Value value = Augment::Identity();
+            for (std::size_t i = 0; i < node->KeysQuantity(); ++i) {
+                if (height > 0) {
+                    value = Augment::Combine(value, Internal(node)->childs[i]->aggregate);
                 }
-                LOG_DEBUG("brother(idx_" << brother_idx << "): " << brother << ' ' << *brother);
-                LOG_DEBUG("node: " << node << ' ' << *node);
-                if (child_idx < Order - 1) {
-                    LOG_DEBUG("Taken key fron parent: " << node->keys[0]);
-                    brother->InsertKey(node->keys[0]);
-                    node->DeleteKey(node->keys[0]);
-                } else {
-                    LOG_DEBUG("Taken key fron parent: " << node->keys[Order - 2]);
-                    brother->InsertKey(node->keys[Order - 2]);
-                    node->DeleteKey(node->keys[Order - 2]);
+                if (!node->marks.Test(i)) {
+                    value = Augment::Combine(value, Augment::Of(node->keys[i]));
                 }
-                LOG_DEBUG("Delete child(" << child_idx << ")");
-                node->DeleteChild(child_idx);
-                if (child_idx < brother_idx) --brother_idx;
-                SplitChild(node, brother_idx);
+            }
+            if (height > 0) {
+                value = Augment::Combine(value, Internal(node)->childs.back()->aggregate);
+            }
+            node->aggregate = std::move(value);
+        }
+    }
+    // Reaggregate the edge nodes of node's subtree bottom up. Returns false
+    // once one keeps its aggregate, so do the nodes above it then.
+    bool ReaggregateEdge(Node* node, int height, bool largest) {
+        if constexpr (kAugmented) {
+            if (height > 0) {
+                auto& childs = Internal(node)->childs;
+                if (!ReaggregateEdge((largest ? childs.back() : childs.front()).get(), height - 1, largest)) {
+                    return false;
+                }
+            }
+            if constexpr (std::equality_comparable<typename Augment::Value>) {
+                typename Augment::Value old = node->aggregate;
+                Reaggregate(node, height);
+                return !(node->aggregate == old);
             } else {
-                LOG_DEBUG("Delete child(" << child_idx << ")");
-                node->DeleteChild(child_idx);
+                Reaggregate(node, height);
             }
         }
-        if (node->KeysQuantity() == node->childs.size()) {
-            LOG_DEBUG("Equal quantity of keys and childs");
-            LOG_DEBUG("Brother: " << brother_idx);
-            Node* child_for_inserting = node->childs[brother_idx].get();
-            T overflow_key = node->keys[brother_idx];
-            child_for_inserting->InsertKey(overflow_key);
-            node->DeleteKey(overflow_key);
-            SplitChild(node, brother_idx); 
+        return true;
+    }
+    // aggregate of the keys of node's subtree in [lo, hi]; inside_lo and
+    // inside_hi tell that the whole subtree lies above lo or below hi
+    typename Augment::Value AggregateRange(Node* node, int height, const T& lo, const T& hi,
+                                           bool inside_lo, bool inside_hi) const {
+        if (inside_lo && inside_hi) {
+            return node->aggregate;
+        }
+        typename Augment::Value value = Augment::Identity();
+        std::size_t quantity = node->KeysQuantity();
+        for (std::size_t idx = inside_lo ? 0 : node->LowerBound(lo); idx <= quantity; ++idx) {
+            bool key_inside_hi = idx < quantity && !(hi < node->keys[idx]);
+            if (height > 0) {
+                bool child_inside_lo = inside_lo || (idx > 0 && !(node->keys[idx - 1] < lo));
+                value = Augment::Combine(value, AggregateRange(Internal(node)->childs[idx].get(), height - 1, lo, hi,
+                                                               child_inside_lo, inside_hi || key_inside_hi));
+            }
+            if (!key_inside_hi) {
+                break;
+            }
+            if (!node->marks.Test(idx)) {
+                value = Augment::Combine(value, Augment::Of(node->keys[idx]));
+            }
         }
-        LOG_DEBUG("END_MERGING");
+        return value;
     }
-    T FindMaximalKey(Node* node) {
-        if (node->IsLeaf()) {
-            return node->keys[node->keys.size() - 1];
-        } else {
-            return FindMaximalKey(node->childs[node->childs.size() - 1].get());
+    static Node* FindMaximalLeaf(Node* node, int height) {
+        for (; height > 0; --height) {
+            node = Internal(node)->childs.back().get();
         }
+        return node;
     }
-    T FindMinimalKey(Node* node) {
-        if (node->IsLeaf()) {
-            return node->keys[0];
-        } else {
-            return FindMinimalKey(node->childs[0].get());
+    static Node* FindMinimalLeaf(Node* node, int height) {
+        for (; height > 0; --height) {
+            node = Internal(node)->childs.front().get();
         }
+        return node;
     }
 
 };
+
+// BTree whose nodes, child arrays and keys live in huge-page regions of the
+// NUMA node of the thread building it
+template <typename T, int Order>
+using HugePageBTree = BTree<T, Order, SortedKeys<T, ArenaAllocator<T>>, HugePageNodes>;
+
+// BTree caching a monoid of every subtree, see tree_aggregate.h
+template <typename T, int Order, typename Augment>
+using AugmentedBTree = BTree<T, Order, SortedKeys<T>, HeapNodes, ScanSearch, Augment>;
+
 #endif
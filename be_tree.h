@@ -0,0 +1,368 @@
+#ifndef MY_BE_TREE
+#define MY_BE_TREE
+
+#include<iostream>
+#include<vector>
+#include<algorithm>
+#include<memory>
+#include<iterator>
+#include"tree_stats.h"
+
+
+// Write-optimized B-epsilon tree with the BTree interface. Keys live in the
+// leaves, internal nodes hold pivots and a buffer of pending inserts and
+// deletes. Updates are appended to the root buffer and pushed one level down
+// in batches when a buffer overflows, Find checks the buffers on its path.
+// Internal nodes have at most Order children, leaves at most Order - 1 keys.
+template <typename T, int Order, int BufferSize = 8 * Order>
+class BeTree {
+    static_assert(Order >= 3, "internal nodes need at least 3 children");
+    static_assert(BufferSize >= 1, "buffers must hold a message");
+public:
+    struct Message {
+        T key;
+        bool insert;
+    };
+
+    struct Node {
+        // pivots of an internal node, childs[i] holds keys in [keys[i - 1], keys[i])
+        std::vector<T> keys;
+        std::vector<std::unique_ptr<Node>> childs;
+        // pending updates sorted by key, at most one per key
+        std::vector<Message> buffer;
+
+        bool IsLeaf() const {
+            return childs.empty();
+        }
+        std::size_t KeysQuantity() const {
+            return keys.size();
+        }
+        std::size_t FindChildIdx(const T& key) const {
+            return std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+        }
+        // buffer messages routed to childs[idx]
+        std::pair<std::size_t, std::size_t> BufferRange(std::size_t idx) const {
+            auto less = [](const Message& message, const T& key) {
+                return message.key < key;
+            };
+            std::size_t lo = 0;
+            std::size_t hi = buffer.size();
+            if (idx > 0) {
+                lo = std::lower_bound(buffer.begin(), buffer.end(), keys[idx - 1], less) - buffer.begin();
+            }
+            if (idx < keys.size()) {
+                hi = std::lower_bound(buffer.begin() + lo, buffer.end(), keys[idx], less) - buffer.begin();
+            }
+            return {lo, hi};
+        }
+    };
+
+    std::unique_ptr<Node> root;
+private:
+    TreeStats stats_;
+public:
+    const TreeStats& Stats() const {
+        return stats_;
+    }
+    void Insert(T key) {
+        Apply(Message{std::move(key), true});
+    }
+    void Delete(const T& key) {
+        Apply(Message{key, false});
+    }
+    bool Find(const T& key) const {
+        const Node* node = root.get();
+        while (node != nullptr && !node->IsLeaf()) {
+            auto it = std::lower_bound(node->buffer.begin(), node->buffer.end(), key,
+                [](const Message& message, const T& k) { return message.key < k; });
+            if (it != node->buffer.end() && !(key < it->key)) {
+                return it->insert;
+            }
+            node = node->childs[node->FindChildIdx(key)].get();
+        }
+        return node != nullptr && std::binary_search(node->keys.begin(), node->keys.end(), key);
+    }
+    // push every pending message down to the leaves
+    void Flush() {
+        if (root == nullptr || root->IsLeaf()) {
+            return;
+        }
+        FlushAll(root.get());
+        FixRoot();
+    }
+    void PrintTreeLevels() const {
+        if (!root) {
+            std::cout << "(empty tree)" << std::endl;
+            return;
+        }
+
+        std::vector<const Node*> current_level = {root.get()};
+        int level = 0;
+        while (!current_level.empty()) {
+            std::vector<const Node*> next_level;
+            std::cout << "Level " << level << ": ";
+            for (const auto* node : current_level) {
+                std::cout << "[";
+                for (std::size_t i = 0; i < node->keys.size(); ++i) {
+                    if (i > 0) std::cout << ", ";
+                    std::cout << node->keys[i];
+                }
+                if (!node->buffer.empty()) {
+                    std::cout << " |";
+                    for (const auto& message : node->buffer) {
+                        std::cout << ' ' << (message.insert ? '+' : '-') << message.key;
+                    }
+                }
+                std::cout << "]  ";
+                for (const auto& child : node->childs) {
+                    next_level.push_back(child.get());
+                }
+            }
+            std::cout << std::endl;
+            current_level = std::move(next_level);
+            ++level;
+        }
+    }
+private:
+    static constexpr std::size_t kMaxLeafKeys = Order - 1;
+    static constexpr std::size_t kMinLeafKeys = (Order - 1) / 2;
+    static constexpr std::size_t kMinChilds = (Order + 1) / 2;
+
+    void Apply(Message message) {
+        if (root == nullptr) {
+            if (!message.insert) {
+                return;
+            }
+            root = std::make_unique<Node>();
+        }
+        if (root->IsLeaf()) {
+            std::vector<Message> batch;
+            batch.push_back(std::move(message));
+            ApplyToLeaf(root.get(), batch.begin(), batch.end());
+        } else {
+            auto it = std::lower_bound(root->buffer.begin(), root->buffer.end(), message.key,
+                [](const Message& m, const T& key) { return m.key < key; });
+            if (it != root->buffer.end() && !(message.key < it->key)) {
+                it->insert = message.insert;
+            } else {
+                root->buffer.insert(it, std::move(message));
+            }
+            while (root->buffer.size() > static_cast<std::size_t>(BufferSize)) {
+                FlushLargest(root.get());
+            }
+        }
+        FixRoot();
+    }
+
+    template <typename It>
+    void ApplyToLeaf(Node* leaf, It first, It last) {
+        std::vector<T> keys;
+        keys.reserve(leaf->keys.size() + (last - first));
+        auto key = leaf->keys.begin();
+        for (; first != last; ++first) {
+            while (key != leaf->keys.end() && *key < first->key) {
+                keys.push_back(std::move(*key++));
+            }
+            bool present = key != leaf->keys.end() && !(first->key < *key);
+            if (present) {
+                ++key;
+            }
+            if (first->insert) {
+                keys.push_back(std::move(first->key));
+            }
+        }
+        std::move(key, leaf->keys.end(), std::back_inserter(keys));
+        leaf->keys = std::move(keys);
+    }
+
+    // newer messages from the parent override those already in the child buffer
+    template <typename It>
+    void MergeIntoBuffer(Node* node, It first, It last) {
+        std::vector<Message> merged;
+        merged.reserve(node->buffer.size() + (last - first));
+        auto old = node->buffer.begin();
+        for (; first != last; ++first) {
+            while (old != node->buffer.end() && old->key < first->key) {
+                merged.push_back(std::move(*old++));
+            }
+            if (old != node->buffer.end() && !(first->key < old->key)) {
+                ++old;
+            }
+            merged.push_back(std::move(*first));
+        }
+        std::move(old, node->buffer.end(), std::back_inserter(merged));
+        node->buffer = std::move(merged);
+    }
+
+    // move the messages of the child with the most of them one level down
+    void FlushLargest(Node* node) {
+        std::size_t best = 0;
+        std::size_t best_count = 0;
+        for (std::size_t i = 0; i < node->childs.size(); ++i) {
+            auto [lo, hi] = node->BufferRange(i);
+            if (hi - lo > best_count) {
+                best = i;
+                best_count = hi - lo;
+            }
+        }
+        FlushChild(node, best);
+    }
+
+    void FlushAll(Node* node) {
+        while (!node->buffer.empty()) {
+            FlushLargest(node);
+        }
+        for (auto& child : node->childs) {
+            if (!child->IsLeaf()) {
+                FlushAll(child.get());
+            }
+        }
+        // flushing the subtrees may have left childs over- or underfull
+        for (std::size_t i = 0; i < node->childs.size(); ++i) {
+            const Node* child = node->childs[i].get();
+            if (Overfull(child) || (Underfull(child) && node->childs.size() > 1)) {
+                FixChild(node, i);
+                i = static_cast<std::size_t>(-1);
+            }
+        }
+    }
+
+    void FlushChild(Node* node, std::size_t idx) {
+        auto [lo, hi] = node->BufferRange(idx);
+        if (lo == hi) {
+            return;
+        }
+        Node* child = node->childs[idx].get();
+        if (child->IsLeaf()) {
+            ApplyToLeaf(child, node->buffer.begin() + lo, node->buffer.begin() + hi);
+        } else {
+            MergeIntoBuffer(child, node->buffer.begin() + lo, node->buffer.begin() + hi);
+        }
+        node->buffer.erase(node->buffer.begin() + lo, node->buffer.begin() + hi);
+        if (!child->IsLeaf()) {
+            while (child->buffer.size() > static_cast<std::size_t>(BufferSize)) {
+                FlushLargest(child);
+            }
+        }
+        FixChild(node, idx);
+    }
+
+    bool Overfull(const Node* node) const {
+        return node->IsLeaf() ? node->keys.size() > kMaxLeafKeys
+                              : node->childs.size() > static_cast<std::size_t>(Order);
+    }
+    bool Underfull(const Node* node) const {
+        return node->IsLeaf() ? node->keys.size() < kMinLeafKeys || node->keys.empty()
+                              : node->childs.size() < kMinChilds;
+    }
+
+    // split or merge childs[idx] until it and the nodes split from it fit
+    void FixChild(Node* node, std::size_t idx) {
+        if (Underfull(node->childs[idx].get()) && node->childs.size() > 1) {
+            if (idx + 1 == node->childs.size()) {
+                --idx;
+            }
+            MergeChilds(node, idx);
+        }
+        std::size_t end = idx + 1;
+        while (idx < end) {
+            if (Overfull(node->childs[idx].get())) {
+                SplitChild(node, idx);
+                ++end;
+            } else {
+                ++idx;
+            }
+        }
+    }
+
+    void SplitChild(Node* node, std::size_t idx) {
+        ++stats_.splits;
+        Node* child = node->childs[idx].get();
+        auto right = std::make_unique<Node>();
+        T pivot = child->IsLeaf() ? SplitLeaf(child, right.get()) : SplitInternal(child, right.get());
+        node->keys.insert(node->keys.begin() + idx, std::move(pivot));
+        node->childs.insert(node->childs.begin() + idx + 1, std::move(right));
+    }
+    // move the upper half of node to right and return the pivot between them
+    T SplitLeaf(Node* node, Node* right) {
+        std::size_t mid = node->keys.size() / 2;
+        right->keys.assign(std::make_move_iterator(node->keys.begin() + mid),
+                           std::make_move_iterator(node->keys.end()));
+        node->keys.erase(node->keys.begin() + mid, node->keys.end());
+        return right->keys.front();
+    }
+    T SplitInternal(Node* node, Node* right) {
+        std::size_t mid = node->childs.size() / 2;
+        T pivot = std::move(node->keys[mid - 1]);
+        right->keys.assign(std::make_move_iterator(node->keys.begin() + mid),
+                           std::make_move_iterator(node->keys.end()));
+        node->keys.erase(node->keys.begin() + mid - 1, node->keys.end());
+        right->childs.assign(std::make_move_iterator(node->childs.begin() + mid),
+                             std::make_move_iterator(node->childs.end()));
+        node->childs.erase(node->childs.begin() + mid, node->childs.end());
+        auto split = std::lower_bound(node->buffer.begin(), node->buffer.end(), pivot,
+            [](const Message& message, const T& key) { return message.key < key; });
+        right->buffer.assign(std::make_move_iterator(split), std::make_move_iterator(node->buffer.end()));
+        node->buffer.erase(split, node->buffer.end());
+        return pivot;
+    }
+
+    // merge childs[idx + 1] into childs[idx]
+    void MergeChilds(Node* node, std::size_t idx) {
+        ++stats_.merges;
+        Node* left = node->childs[idx].get();
+        Node* right = node->childs[idx + 1].get();
+        std::size_t junction = left->childs.size();
+        if (!left->IsLeaf()) {
+            left->keys.push_back(std::move(node->keys[idx]));
+        }
+        std::move(right->keys.begin(), right->keys.end(), std::back_inserter(left->keys));
+        std::move(right->childs.begin(), right->childs.end(), std::back_inserter(left->childs));
+        std::move(right->buffer.begin(), right->buffer.end(), std::back_inserter(left->buffer));
+        node->keys.erase(node->keys.begin() + idx);
+        node->childs.erase(node->childs.begin() + idx + 1);
+        if (!left->IsLeaf()) {
+            // an underfull child left alone under its parent ends up next to the junction
+            if (Underfull(left->childs[junction - 1].get())) {
+                FixChild(left, junction - 1);
+            } else if (Underfull(left->childs[junction].get())) {
+                FixChild(left, junction);
+            }
+            while (left->buffer.size() > static_cast<std::size_t>(BufferSize)) {
+                FlushLargest(left);
+            }
+        }
+    }
+
+    void FixRoot() {
+        while (Overfull(root.get())) {
+            auto new_root = std::make_unique<Node>();
+            new_root->childs.push_back(std::move(root));
+            root = std::move(new_root);
+            FixChild(root.get(), 0);
+        }
+        while (!root->IsLeaf() && root->childs.size() == 1) {
+            std::unique_ptr<Node> child = std::move(root->childs[0]);
+            if (child->IsLeaf()) {
+                ApplyToLeaf(child.get(), root->buffer.begin(), root->buffer.end());
+            } else {
+                MergeIntoBuffer(child.get(), root->buffer.begin(), root->buffer.end());
+            }
+            root = std::move(child);
+            if (Overfull(root.get())) {
+                FixRoot();
+                return;
+            }
+            if (!root->IsLeaf()) {
+                while (root->buffer.size() > static_cast<std::size_t>(BufferSize)) {
+                    FlushLargest(root.get());
+                }
+            }
+        }
+        if (root->IsLeaf() && root->keys.empty()) {
+            root = nullptr;
+        }
+    }
+};
+
+#endif
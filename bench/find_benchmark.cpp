@@ -0,0 +1,66 @@
+// Compares plain Find with interleaved FindAsync lookups on trees larger than cache.
+#include<chrono>
+#include<cstdio>
+#include<random>
+#include<vector>
+#include"../b_tree.h"
+#include"../two_three_tree.h"
+#include"../find_task.h"
+
+namespace {
+
+template <typename F>
+double Seconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Tree>
+void Run(const char* name, Tree& tree, const std::vector<int>& keys) {
+    std::size_t hits = 0;
+    double plain = Seconds([&] {
+        for (int key : keys) {
+            hits += tree.Find(key);
+        }
+    });
+    std::printf("%-12s Find            %6.3fs (%zu hits)\n", name, plain, hits);
+    for (std::size_t group : {1, 4, 8, 16, 32}) {
+        hits = 0;
+        double interleaved = Seconds([&] {
+            for (bool found : FindInterleaved(tree, keys, group)) {
+                hits += found;
+            }
+        });
+        std::printf("%-12s interleaved x%-2zu %6.3fs (%zu hits)\n", name, group, interleaved, hits);
+    }
+}
+
+}  // namespace
+
+int main() {
+    const int kKeys = 4000000;
+    const int kLookups = 2000000;
+    std::mt19937 g(42);
+    std::vector<int> inserted(kKeys);
+    for (int& key : inserted) {
+        key = static_cast<int>(g() >> 1);
+    }
+    std::vector<int> lookups(kLookups);
+    for (int i = 0; i < kLookups; ++i) {
+        lookups[i] = i % 2 == 0 ? inserted[g() % kKeys] : static_cast<int>(g() >> 1);
+    }
+
+    BTree<int, 16> b_tree;
+    for (int key : inserted) {
+        b_tree.Insert(key);
+    }
+    Run("BTree<16>", b_tree, lookups);
+
+    TwoThreeTree<int> two_three_tree;
+    for (int key : inserted) {
+        two_three_tree.Insert(key);
+    }
+    Run("TwoThreeTree", two_three_tree, lookups);
+    return 0;
+}
@@ -0,0 +1,166 @@
+#ifndef MY_FIND_TASK
+#define MY_FIND_TASK
+
+#include<coroutine>
+#include<cstddef>
+#include<exception>
+#include<new>
+#include<utility>
+#include<vector>
+
+
+// Lookup coroutine returned by FindAsync. It starts suspended and suspends
+// again at each node after prefetching it, so a caller can run other
+// lookups while the cache line is on its way (see FindInterleaved).
+class FindTask {
+public:
+    struct promise_type {
+        bool found = false;
+
+        FindTask get_return_object() {
+            return FindTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_value(bool value) {
+            found = value;
+        }
+        void unhandled_exception() {
+            std::terminate();
+        }
+
+        // lookups of one tree have frames of one size, recycle them per thread
+        static void* operator new(std::size_t size) {
+            FrameCache& cache = Cache();
+            if (size == cache.frame_size && !cache.frames.empty()) {
+                void* frame = cache.frames.back();
+                cache.frames.pop_back();
+                return frame;
+            }
+            return ::operator new(size);
+        }
+        static void operator delete(void* frame, std::size_t size) {
+            FrameCache& cache = Cache();
+            if (cache.frame_size != size) {
+                cache.Reset(size);
+            }
+            if (cache.frames.size() < kMaxCachedFrames) {
+                cache.frames.push_back(frame);
+            } else {
+                ::operator delete(frame);
+            }
+        }
+    };
+
+    explicit FindTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    FindTask(FindTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    FindTask& operator=(FindTask&& other) noexcept {
+        std::swap(handle_, other.handle_);
+        return *this;
+    }
+    ~FindTask() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool Done() const {
+        return handle_.done();
+    }
+    // run until the next node access
+    void Resume() {
+        handle_.resume();
+    }
+    bool Result() const {
+        return handle_.promise().found;
+    }
+    // run to completion without interleaving
+    bool Get() {
+        while (!Done()) {
+            Resume();
+        }
+        return Result();
+    }
+private:
+    static constexpr std::size_t kMaxCachedFrames = 64;
+
+    struct FrameCache {
+        std::size_t frame_size = 0;
+        std::vector<void*> frames;
+
+        void Reset(std::size_t size) {
+            for (void* frame : frames) {
+                ::operator delete(frame);
+            }
+            frames.clear();
+            frame_size = size;
+        }
+        ~FrameCache() {
+            Reset(0);
+        }
+    };
+    static FrameCache& Cache() {
+        thread_local FrameCache cache;
+        return cache;
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// co_await Prefetch{address} starts loading address and yields to the scheduler
+struct Prefetch {
+    const void* first;
+    const void* second = nullptr;
+
+    bool await_ready() const noexcept {
+        __builtin_prefetch(first);
+        if (second != nullptr) {
+            __builtin_prefetch(second);
+        }
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+    void await_resume() const noexcept {}
+};
+
+// Answer tree.Find for every key, keeping group lookups in flight and
+// switching between them at each node so their cache misses overlap.
+template <typename Tree, typename T>
+std::vector<bool> FindInterleaved(Tree& tree, const std::vector<T>& keys, std::size_t group = 12) {
+    std::vector<bool> found(keys.size());
+    std::vector<FindTask> tasks;
+    std::vector<std::size_t> key_idx;
+    tasks.reserve(group);
+    key_idx.reserve(group);
+    std::size_t next = 0;
+    while (next < keys.size() && tasks.size() < group) {
+        tasks.push_back(tree.FindAsync(keys[next]));
+        key_idx.push_back(next++);
+    }
+    while (!tasks.empty()) {
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            tasks[i].Resume();
+            if (!tasks[i].Done()) {
+                continue;
+            }
+            found[key_idx[i]] = tasks[i].Result();
+            if (next < keys.size()) {
+                tasks[i] = tree.FindAsync(keys[next]);
+                key_idx[i] = next++;
+            } else {
+                tasks[i] = std::move(tasks.back());
+                key_idx[i] = key_idx.back();
+                tasks.pop_back();
+                key_idx.pop_back();
+                --i;
+            }
+        }
+    }
+    return found;
+}
+
+#endif
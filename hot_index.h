@@ -0,0 +1,108 @@
+#ifndef MY_HOT_INDEX
+#define MY_HOT_INDEX
+
+#include<algorithm>
+#include<cstddef>
+#include<vector>
+
+
+// Copy of the separators of a tree's top levels, built for descents: the
+// separators in order, laid out as a static search tree of cache lines, and
+// for every gap between two of them the node that covers it on the first
+// level below the copy. A lookup reads one line per tier, each searched by
+// counting the keys less than the target, a loop without branches that the
+// compiler turns into vector compares for arithmetic keys; 4096 int
+// separators take three lines. The owner rebuilds it with Assign whenever
+// the mirrored levels change.
+template <typename T, typename Entry>
+class HotIndex {
+public:
+    explicit HotIndex(int levels) : levels_(levels) {}
+
+    // levels of the tree mirrored, counted from the root
+    int Levels() const {
+        return levels_;
+    }
+    bool Valid() const {
+        return valid_;
+    }
+    void Invalidate() {
+        valid_ = false;
+    }
+    // separators in order and entries.size() == separators.size() + 1 subtrees around them
+    void Assign(std::vector<T> separators, std::vector<Entry> entries) {
+        separators_ = std::move(separators);
+        entries_ = std::move(entries);
+        tiers_.clear();
+        if (!separators_.empty()) {
+            // the bottom tier holds every separator, each tier above the last key of every line below
+            std::vector<T> tier = separators_;
+            while (true) {
+                // padded with its last key, which leaves every count below unchanged
+                tier.resize((tier.size() + kLine - 1) / kLine * kLine, tier.back());
+                std::vector<Line> lines(tier.size() / kLine);
+                for (std::size_t i = 0; i < tier.size(); ++i) {
+                    lines[i / kLine].keys[i % kLine] = tier[i];
+                }
+                tiers_.push_back(std::move(lines));
+                if (tier.size() == kLine) {
+                    break;
+                }
+                std::vector<T> upper;
+                for (std::size_t i = kLine - 1; i < tier.size(); i += kLine) {
+                    upper.push_back(tier[i]);
+                }
+                tier = std::move(upper);
+            }
+            std::reverse(tiers_.begin(), tiers_.end());
+        }
+        valid_ = true;
+    }
+    // number of separators less than key
+    std::size_t Rank(const T& key) const {
+        std::size_t idx = 0;
+        for (const auto& tier : tiers_) {
+            const Line& line = tier[std::min(idx, tier.size() - 1)];
+            idx = std::min(idx, tier.size() - 1) * kLine + CountLess(line, key);
+        }
+        return std::min(idx, separators_.size());
+    }
+    bool IsSeparator(std::size_t rank, const T& key) const {
+        return rank < separators_.size() && separators_[rank] == key;
+    }
+    Entry EntryAt(std::size_t rank) const {
+        return entries_[rank];
+    }
+    std::size_t Separators() const {
+        return separators_.size();
+    }
+    std::size_t Bytes() const {
+        std::size_t bytes = separators_.size() * sizeof(T) + entries_.size() * sizeof(Entry);
+        for (const auto& tier : tiers_) {
+            bytes += tier.size() * sizeof(Line);
+        }
+        return bytes;
+    }
+private:
+    static constexpr std::size_t kLine = std::max<std::size_t>(64 / sizeof(T), 2);
+    struct alignas(64) Line {
+        T keys[kLine];
+    };
+
+    int levels_;
+    bool valid_ = false;
+    // top tier first, it is a single line
+    std::vector<std::vector<Line>> tiers_;
+    std::vector<T> separators_;
+    std::vector<Entry> entries_;
+
+    static std::size_t CountLess(const Line& line, const T& key) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < kLine; ++i) {
+            count += static_cast<std::size_t>(line.keys[i] < key);
+        }
+        return count;
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef MY_HYBRID_SET
+#define MY_HYBRID_SET
+
+#include<algorithm>
+#include<cstddef>
+#include<cstdint>
+#include<iterator>
+#include<vector>
+#include<bit>
+#include<limits>
+#include"b_tree.h"
+
+
+// BTree of dense unsigned ids, every node keeping its keys in the container
+// of HybridKeys that suits them. A wide Order gives leaves that span long id
+// ranges, which is where bitmaps and runs pay off.
+template <typename T, int Order>
+using HybridBTree = BTree<T, Order, HybridKeys<T>>;
+
+namespace hybrid_set {
+
+// A piece of a tree in key order: the keys of a leaf, or one key of an
+// internal node (or of a flat tree).
+template <typename T>
+struct Segment {
+    const HybridKeys<T>* keys = nullptr;
+    T key = T();
+
+    T First() const {
+        return keys ? (*keys)[0] : key;
+    }
+    T Last() const {
+        return keys ? (*keys)[keys->size() - 1] : key;
+    }
+    bool IsBitmap() const {
+        return keys && keys->Kind() == HybridKeys<T>::Container::kBitmap;
+    }
+    std::size_t Count() const {
+        return keys ? keys->size() : 1;
+    }
+    bool Contains(T k) const {
+        return keys ? keys->Contains(k) : k == key;
+    }
+    template <typename Visit>
+    void ForEachBetween(T lo, T hi, Visit&& visit) const {
+        if (keys) {
+            keys->ForEachBetween(lo, hi, visit);
+        } else if (lo <= key && key <= hi) {
+            visit(key);
+        }
+    }
+};
+
+template <typename Node, typename T>
+void Collect(const Node* node, std::vector<Segment<T>>& segments) {
+    if (node->keys.empty()) {
+        return;
+    }
+    if (node->leaf) {
+        segments.push_back(Segment<T>{&node->keys});
+        return;
+    }
+    std::vector<T> keys = node->keys.Decode();
+    auto children = node->Children();
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        Collect(children[i].get(), segments);
+        segments.push_back(Segment<T>{nullptr, keys[i]});
+    }
+    Collect(children[keys.size()].get(), segments);
+}
+
+// the tree's keys in order, as whole containers where there are some
+template <typename Tree, typename T>
+std::vector<Segment<T>> Segments(Tree& tree) {
+    std::vector<Segment<T>> segments;
+    if (tree.Tombstones() > 0) {
+        tree.Compact();
+    }
+    if (tree.root) {
+        Collect(tree.root.get(), segments);
+    } else {
+        tree.ForEachInRange(T(0), std::numeric_limits<T>::max(), [&segments](const T& key) {
+            segments.push_back(Segment<T>{nullptr, key});
+        });
+    }
+    return segments;
+}
+
+// Appends to out the keys in [lo, hi] of a & b (intersect) or a | b. Two
+// bitmaps are combined a word at a time into a buffer, a loop the compiler
+// vectorizes, then the buffer is read off by counting trailing zeros.
+template <typename T>
+void Combine(const Segment<T>& a, const Segment<T>& b, T lo, T hi, bool intersect, std::vector<T>& out) {
+    if (a.IsBitmap() && b.IsBitmap()) {
+        std::uint64_t from = lo >> 6;
+        std::size_t words = static_cast<std::size_t>((hi >> 6) - from + 1);
+        std::vector<std::uint64_t> combined(words);
+        for (std::size_t i = 0; i < words; ++i) {
+            std::uint64_t x = a.keys->Word(from + i);
+            std::uint64_t y = b.keys->Word(from + i);
+            combined[i] = intersect ? x & y : x | y;
+        }
+        for (std::size_t i = 0; i < words; ++i) {
+            std::uint64_t word = combined[i] & HybridKeys<T>::EdgeMask(from + i, lo, hi);
+            for (; word != 0; word &= word - 1) {
+                out.push_back(static_cast<T>((from + i) * 64 + std::countr_zero(word)));
+            }
+        }
+        return;
+    }
+    if (intersect) {
+        // probe the larger container with the keys of the smaller one
+        const Segment<T>& small = a.Count() <= b.Count() ? a : b;
+        const Segment<T>& large = a.Count() <= b.Count() ? b : a;
+        small.ForEachBetween(lo, hi, [&large, &out](T key) {
+            if (large.Contains(key)) {
+                out.push_back(key);
+            }
+        });
+        return;
+    }
+    std::vector<T> left;
+    std::vector<T> right;
+    a.ForEachBetween(lo, hi, [&left](T key) { left.push_back(key); });
+    b.ForEachBetween(lo, hi, [&right](T key) { right.push_back(key); });
+    std::set_union(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(out));
+}
+
+// Walks the segments of both trees together. Keys of a segment that overlaps
+// no segment of the other tree go to the union as they are; where two
+// segments overlap, their common range is combined container to container.
+template <typename T>
+std::vector<T> Merge(const std::vector<Segment<T>>& a, const std::vector<Segment<T>>& b, bool intersect) {
+    std::vector<T> out;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    // keys below from are done, the current segments may be partly consumed
+    std::uint64_t from = 0;
+    auto rest = [&](const Segment<T>& segment) {
+        if (!intersect && from <= segment.Last()) {
+            segment.ForEachBetween(static_cast<T>(std::max<std::uint64_t>(from, segment.First())), segment.Last(),
+                [&out](T key) { out.push_back(key); });
+        }
+    };
+    while (i < a.size() || j < b.size()) {
+        if (j == b.size() || (i < a.size() && a[i].Last() < b[j].First())) {
+            rest(a[i++]);
+            continue;
+        }
+        if (i == a.size() || b[j].Last() < a[i].First()) {
+            rest(b[j++]);
+            continue;
+        }
+        T lo = std::max(a[i].First(), b[j].First());
+        T hi = std::min(a[i].Last(), b[j].Last());
+        if (!intersect && from < lo) {
+            // only the segment starting first has keys before the overlap
+            const Segment<T>& first = a[i].First() < lo ? a[i] : b[j];
+            first.ForEachBetween(static_cast<T>(std::max<std::uint64_t>(from, first.First())), static_cast<T>(lo - 1),
+                [&out](T key) { out.push_back(key); });
+        }
+        Combine(a[i], b[j], static_cast<T>(std::max<std::uint64_t>(from, lo)), hi, intersect, out);
+        from = std::uint64_t(hi) + 1;
+        bool a_done = a[i].Last() == hi;
+        bool b_done = b[j].Last() == hi;
+        i += a_done;
+        j += b_done;
+    }
+    return out;
+}
+
+template <typename Tree, typename T>
+Tree Build(const std::vector<T>& keys) {
+    Tree result;
+    for (const T& key : keys) {
+        result.Insert(key);
+    }
+    return result;
+}
+
+}  // namespace hybrid_set
+
+// Keys present in both trees. Tombstones of lazy deletes are compacted first.
+template <typename T, int Order>
+HybridBTree<T, Order> Intersect(HybridBTree<T, Order>& a, HybridBTree<T, Order>& b) {
+    auto keys = hybrid_set::Merge(hybrid_set::Segments<HybridBTree<T, Order>, T>(a),
+        hybrid_set::Segments<HybridBTree<T, Order>, T>(b), true);
+    return hybrid_set::Build<HybridBTree<T, Order>>(keys);
+}
+
+// Keys present in either tree.
+template <typename T, int Order>
+HybridBTree<T, Order> Union(HybridBTree<T, Order>& a, HybridBTree<T, Order>& b) {
+    auto keys = hybrid_set::Merge(hybrid_set::Segments<HybridBTree<T, Order>, T>(a),
+        hybrid_set::Segments<HybridBTree<T, Order>, T>(b), false);
+    return hybrid_set::Build<HybridBTree<T, Order>>(keys);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef MY_LOOKUP_FILTER
+#define MY_LOOKUP_FILTER
+
+#include<algorithm>
+#include<cmath>
+#include<concepts>
+#include<cstddef>
+#include<cstdint>
+#include<functional>
+#include<vector>
+
+
+template <typename T>
+concept Hashable = requires(const T& key) {
+    { std::hash<T>{}(key) } -> std::convertible_to<std::size_t>;
+};
+
+struct FilterStats {
+    std::size_t bytes = 0;
+    // keys added since the last rebuild, and deletes the filter still answers "maybe" for
+    std::size_t keys = 0;
+    std::size_t stale = 0;
+    std::size_t rebuilds = 0;
+    // for the current key count and size
+    double expected_fpr = 0;
+};
+
+// Blocked Bloom filter over the keys of one tree. All bits of a key lie in
+// one 64-byte block, so a lookup costs a single cache miss. Bloom filters
+// cannot forget a key: deletes are only counted, and once they make up
+// max_stale of the keys, or the keys outgrow the size picked for fpr, the
+// owner rebuilds the filter from its keys (Reset, then Add each).
+template <typename T>
+class LookupFilter {
+public:
+    // max_bytes == 0 leaves the size to fpr, otherwise it caps it and the rate grows instead
+    LookupFilter(double fpr, std::size_t max_bytes, double max_stale = 0.25)
+        : fpr_(std::clamp(fpr, 1e-6, 0.5))
+        , max_bytes_(max_bytes)
+        , max_stale_(max_stale) {
+        // bits per key of a plain Bloom filter, plus a tenth for the uneven blocks
+        bits_per_key_ = 1.1 * -std::log(fpr_) / (std::log(2.0) * std::log(2.0));
+        hashes_ = std::clamp(static_cast<int>(std::lround(bits_per_key_ / 1.1 * std::log(2.0))), 1, 16);
+        Reset(0);
+    }
+
+    // forget every key and make room for expected ones
+    void Reset(std::size_t expected) {
+        capacity_ = std::max<std::size_t>(expected * 2, 64);
+        std::size_t blocks = static_cast<std::size_t>(std::ceil(capacity_ * bits_per_key_ / kBlockBits));
+        if (max_bytes_ != 0) {
+            blocks = std::min(blocks, std::max<std::size_t>(max_bytes_ / sizeof(Block), 1));
+        }
+        blocks_.assign(std::max<std::size_t>(blocks, 1), Block());
+        keys_ = 0;
+        stale_ = 0;
+        ++rebuilds_;
+    }
+    // true when the filter should be rebuilt
+    bool Add(const T& key) {
+        std::uint64_t hash = Hash(key);
+        Block& block = blocks_[BlockIdx(hash)];
+        std::uint64_t step = Step(hash);
+        for (int i = 0; i < hashes_; ++i) {
+            std::uint64_t bit = (hash + i * step) & (kBlockBits - 1);
+            block.words[bit / 64] |= std::uint64_t(1) << (bit % 64);
+        }
+        ++keys_;
+        return keys_ > capacity_ && !AtBudget();
+    }
+    bool Remove() {
+        ++stale_;
+        return stale_ > max_stale_ * keys_;
+    }
+    // false only for keys never added since the last Reset
+    bool MayContain(const T& key) const {
+        std::uint64_t hash = Hash(key);
+        const Block& block = blocks_[BlockIdx(hash)];
+        std::uint64_t step = Step(hash);
+        std::uint64_t found = 1;
+        for (int i = 0; i < hashes_; ++i) {
+            std::uint64_t bit = (hash + i * step) & (kBlockBits - 1);
+            found &= block.words[bit / 64] >> (bit % 64);
+        }
+        return found != 0;
+    }
+    FilterStats Stats() const {
+        FilterStats stats;
+        stats.bytes = blocks_.size() * sizeof(Block);
+        stats.keys = keys_;
+        stats.stale = stale_;
+        stats.rebuilds = rebuilds_ - 1;
+        double bits_per_key = keys_ == 0 ? 0 : static_cast<double>(stats.bytes) * 8 / keys_;
+        stats.expected_fpr = keys_ == 0 ? 0 : std::pow(1 - std::exp(-hashes_ / bits_per_key), hashes_);
+        return stats;
+    }
+private:
+    static constexpr std::size_t kBlockBits = 512;
+    struct alignas(64) Block {
+        std::uint64_t words[kBlockBits / 64] = {};
+    };
+
+    double fpr_;
+    std::size_t max_bytes_;
+    double max_stale_;
+    double bits_per_key_ = 0;
+    int hashes_ = 1;
+    std::vector<Block> blocks_;
+    std::size_t capacity_ = 0;
+    std::size_t keys_ = 0;
+    std::size_t stale_ = 0;
+    std::size_t rebuilds_ = 0;
+
+    // std::hash of integers is the identity, mix it (splitmix64 finalizer)
+    static std::uint64_t Hash(const T& key) {
+        std::uint64_t hash = std::hash<T>{}(key);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return hash ^ (hash >> 31);
+    }
+    std::size_t BlockIdx(std::uint64_t hash) const {
+        // multiply-shift maps the high bits onto the blocks without a division
+        return static_cast<std::size_t>(((hash >> 32) * blocks_.size()) >> 32);
+    }
+    // odd, so the probes of one key cycle through all bits of the block
+    static std::uint64_t Step(std::uint64_t hash) {
+        return ((hash * 0x9e3779b97f4a7c15ULL) >> 40) | 1;
+    }
+    bool AtBudget() const {
+        return max_bytes_ != 0 && blocks_.size() * sizeof(Block) * 2 > max_bytes_;
+    }
+};
+
+#endif
@@ -1,14 +1,34 @@
 #include"test_b_tree.h"
 #include"test_two_three_tree.h"
+#include"test_be_tree.h"
+#include"test_sharded_b_tree.h"
+#include"test_multiset_b_tree.h"
+#include"test_shared_b_tree.h"
+#include"test_static_b_tree.h"
 #include"two_three_tree.h"
 #include"b_tree.h"
 
 
 int main() {
-    // TestTwoThreeTree test;
-    // test.RunTests();
+    TestTwoThreeTree two_three_test;
+    two_three_test.RunTests();
     TestBTree<int, 5> test;
     test.RunAllTests();
+    TestBeTree<int, 5> be_test;
+    be_test.RunAllTests();
+    TestShardedBTree<16> sharded_test;
+    sharded_test.RunAllTests();
+    TestMultisetBTree<8> multiset_test;
+    multiset_test.RunAllTests();
+    TestSharedBTree<8> shared_test;
+    shared_test.RunAllTests();
+    TestStaticBTree<5> static_test;
+    static_test.RunAllTests();
+    TestStaticBTree<16> wide_static_test;
+    wide_static_test.RunAllTests();
+#ifdef ENABLE_PROFILING
+    TreeProfiler::ThisThread().Report(std::cout);
+#endif
     // TwoThreeTree<int> tree;
     // tree.Insert(10);
     // tree.Insert(20);
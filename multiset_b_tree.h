@@ -0,0 +1,135 @@
+#ifndef MY_MULTISET_B_TREE
+#define MY_MULTISET_B_TREE
+
+#include<cstddef>
+#include<utility>
+#include"b_tree.h"
+
+
+// Key of a multiset node: compared and hashed by key only, so the count
+// travels with the key through every split, merge and rotation and may be
+// changed in place through BTree::Lookup.
+template <typename T>
+struct Counted {
+    T key;
+    mutable std::size_t count = 1;
+
+    bool operator<(const Counted& other) const {
+        return key < other.key;
+    }
+    bool operator==(const Counted& other) const {
+        return key == other.key;
+    }
+    friend std::ostream& operator<<(std::ostream& os, const Counted& counted) {
+        return os << counted.key << "x" << counted.count;
+    }
+};
+
+template <typename T>
+struct std::hash<Counted<T>> {
+    std::size_t operator()(const Counted<T>& counted) const {
+        return std::hash<T>{}(counted.key);
+    }
+};
+
+// BTree keeping every key once with the number of times it was inserted.
+// The count sits next to the key in its node, so Count, InsertDup and
+// EraseOne take a single descent; only EraseOne of the last occurrence
+// descends again to delete the key. Underlying() gives access to the options
+// of BTree (flat mode, lookup filter, hot index), except lazy deletes.
+template <typename T, int Order>
+class MultisetBTree {
+public:
+    // a key revived by a lazy delete would come back with its old count
+    class Tree : public BTree<Counted<T>, Order> {
+    public:
+        using BTree<Counted<T>, Order>::BTree;
+        void EnableLazyDelete(double max_density = 0.25) = delete;
+    };
+
+    void InsertDup(T key, std::size_t times = 1) {
+        if (times == 0) {
+            return;
+        }
+        total_ += times;
+        Counted<T> counted{std::move(key), times};
+        typename Tree::Cursor hint;
+        if (const Counted<T>* stored = tree_.Lookup(hint, counted)) {
+            stored->count += times;
+            return;
+        }
+        // resumes at the leaf the lookup ended on
+        tree_.Insert(hint, counted);
+    }
+    std::size_t Count(const T& key) {
+        const Counted<T>* stored = tree_.Lookup(Probe(key));
+        return stored ? stored->count : 0;
+    }
+    bool Contains(const T& key) {
+        return tree_.Find(Probe(key));
+    }
+    // remove one occurrence, false if there was none
+    bool EraseOne(const T& key) {
+        Counted<T> probe = Probe(key);
+        const Counted<T>* stored = tree_.Lookup(probe);
+        if (stored == nullptr) {
+            return false;
+        }
+        --total_;
+        if (--stored->count == 0) {
+            tree_.Delete(probe);
+        }
+        return true;
+    }
+    // remove every occurrence and return how many there were
+    std::size_t EraseAll(const T& key) {
+        Counted<T> probe = Probe(key);
+        const Counted<T>* stored = tree_.Lookup(probe);
+        if (stored == nullptr) {
+            return 0;
+        }
+        std::size_t count = stored->count;
+        total_ -= count;
+        tree_.Delete(probe);
+        return count;
+    }
+    // occurrences of the keys in [lo, hi]
+    std::size_t CountRange(const T& lo, const T& hi) {
+        std::size_t sum = 0;
+        ForEachInRange(lo, hi, [&sum](const T&, std::size_t count) {
+            sum += count;
+        });
+        return sum;
+    }
+    // visit(key, count) for the distinct keys in [lo, hi], in order
+    template <typename Visit>
+    void ForEachInRange(const T& lo, const T& hi, Visit&& visit) {
+        tree_.ForEachInRange(Probe(lo), Probe(hi), [&visit](const Counted<T>& counted) {
+            visit(counted.key, counted.count);
+        });
+    }
+    // distinct keys
+    std::size_t Size() const {
+        return tree_.Size();
+    }
+    // occurrences of all keys
+    std::size_t TotalCount() const {
+        return total_;
+    }
+    void Clear() {
+        tree_.Clear();
+        total_ = 0;
+    }
+    Tree& Underlying() {
+        return tree_;
+    }
+private:
+    Tree tree_;
+    std::size_t total_ = 0;
+
+    static Counted<T> Probe(const T& key) {
+        return Counted<T>{key, 0};
+    }
+};
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef MY_NODE_ARENA
+#define MY_NODE_ARENA
+
+#include<algorithm>
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<cstdlib>
+#include<map>
+#include<memory>
+#include<mutex>
+#include<new>
+#include<vector>
+#ifdef __linux__
+    #include<sched.h>
+    #include<sys/mman.h>
+    #include<sys/syscall.h>
+    #include<unistd.h>
+#endif
+
+
+// Memory of one NUMA node, or of every arena when asked per arena
+struct ArenaStats {
+    int numa_node = -1;
+    std::size_t regions = 0;
+    // regions the kernel accepted MADV_HUGEPAGE for
+    std::size_t huge_page_regions = 0;
+    std::size_t reserved_bytes = 0;
+    std::size_t used_bytes = 0;
+};
+
+// Per-thread allocator carving small blocks out of 2 MiB regions. Regions are
+// mmap-ed with MADV_HUGEPAGE, so a tree's nodes share a few TLB entries, and
+// bound to the NUMA node of the thread that created the arena. Without mmap,
+// huge pages or NUMA the regions come from aligned_alloc and the first-touch
+// placement of the kernel. Blocks may be freed by any thread; an arena whose
+// thread exits is handed to the next thread that needs one.
+class NodeArena {
+public:
+    static constexpr std::size_t kRegionSize = std::size_t(2) << 20;
+    // larger blocks go to operator new
+    static constexpr std::size_t kMaxBlock = std::size_t(64) << 10;
+
+    static NodeArena& ForThisThread() {
+        thread_local Owner owner;
+        return *owner.arena;
+    }
+
+    void* Allocate(std::size_t size) {
+        if (size > kMaxBlock) {
+            return ::operator new(size);
+        }
+        std::size_t cls = SizeClass(size);
+        if (free_[cls] == nullptr) {
+            CollectRemoteFrees();
+        }
+        FreeBlock* block = free_[cls];
+        if (block != nullptr) {
+            free_[cls] = block->next;
+        } else {
+            block = static_cast<FreeBlock*>(Carve(ClassSize(cls)));
+        }
+        used_bytes_.fetch_add(ClassSize(cls), std::memory_order_relaxed);
+        return block;
+    }
+
+    // size must be the one passed to Allocate
+    static void Deallocate(void* ptr, std::size_t size) {
+        if (size > kMaxBlock) {
+            ::operator delete(ptr);
+            return;
+        }
+        auto* region = reinterpret_cast<Region*>(reinterpret_cast<std::uintptr_t>(ptr) & ~(kRegionSize - 1));
+        NodeArena* arena = region->arena;
+        std::size_t cls = SizeClass(size);
+        arena->used_bytes_.fetch_sub(ClassSize(cls), std::memory_order_relaxed);
+        auto* block = static_cast<FreeBlock*>(ptr);
+        block->cls = cls;
+        if (arena == current_) {
+            block->next = arena->free_[cls];
+            arena->free_[cls] = block;
+            return;
+        }
+        block->next = arena->remote_free_.load(std::memory_order_relaxed);
+        while (!arena->remote_free_.compare_exchange_weak(block->next, block,
+                                                          std::memory_order_release,
+                                                          std::memory_order_relaxed)) {
+        }
+    }
+
+    ArenaStats Stats() const {
+        ArenaStats stats;
+        stats.numa_node = numa_node_;
+        stats.regions = regions_.load(std::memory_order_relaxed);
+        stats.huge_page_regions = huge_page_regions_.load(std::memory_order_relaxed);
+        stats.reserved_bytes = stats.regions * kRegionSize;
+        stats.used_bytes = used_bytes_.load(std::memory_order_relaxed);
+        return stats;
+    }
+    // memory of all arenas summed per NUMA node
+    static std::vector<ArenaStats> MemoryStats() {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::map<int, ArenaStats> per_node;
+        for (const auto& arena : registry.arenas) {
+            ArenaStats stats = arena->Stats();
+            ArenaStats& total = per_node[stats.numa_node];
+            total.numa_node = stats.numa_node;
+            total.regions += stats.regions;
+            total.huge_page_regions += stats.huge_page_regions;
+            total.reserved_bytes += stats.reserved_bytes;
+            total.used_bytes += stats.used_bytes;
+        }
+        std::vector<ArenaStats> result;
+        for (const auto& [node, stats] : per_node) {
+            result.push_back(stats);
+        }
+        return result;
+    }
+    int NumaNode() const {
+        return numa_node_;
+    }
+private:
+    static constexpr std::size_t kMinBlockShift = 4;
+    static constexpr std::size_t kClasses = 13;  // 16 B .. 64 KiB
+
+    struct FreeBlock {
+        FreeBlock* next;
+        std::size_t cls;
+    };
+    // start of every region, lets Deallocate find the arena of a block
+    struct alignas(64) Region {
+        NodeArena* arena;
+    };
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<NodeArena>> arenas;
+        std::vector<NodeArena*> orphans;
+    };
+    struct Owner {
+        NodeArena* arena;
+        Owner() : arena(Adopt()) {
+            current_ = arena;
+        }
+        ~Owner() {
+            current_ = nullptr;
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.orphans.push_back(arena);
+        }
+    };
+
+    inline static thread_local NodeArena* current_ = nullptr;
+
+    FreeBlock* free_[kClasses] = {};
+    std::atomic<FreeBlock*> remote_free_{nullptr};
+    char* bump_ = nullptr;
+    char* bump_end_ = nullptr;
+    int numa_node_ = -1;
+    std::atomic<std::size_t> regions_{0};
+    std::atomic<std::size_t> huge_page_regions_{0};
+    std::atomic<std::size_t> used_bytes_{0};
+
+    static Registry& GetRegistry() {
+        // never destroyed, blocks may be freed during static destruction
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    static NodeArena* Adopt() {
+        int node = CurrentNumaNode();
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (std::size_t i = 0; i < registry.orphans.size(); ++i) {
+            NodeArena* arena = registry.orphans[i];
+            if (arena->numa_node_ == node) {
+                registry.orphans.erase(registry.orphans.begin() + i);
+                return arena;
+            }
+        }
+        registry.arenas.push_back(std::make_unique<NodeArena>());
+        registry.arenas.back()->numa_node_ = node;
+        return registry.arenas.back().get();
+    }
+
+    static std::size_t SizeClass(std::size_t size) {
+        std::size_t cls = 0;
+        while ((std::size_t(1) << (cls + kMinBlockShift)) < size) {
+            ++cls;
+        }
+        return cls;
+    }
+    static std::size_t ClassSize(std::size_t cls) {
+        return std::size_t(1) << (cls + kMinBlockShift);
+    }
+
+    void CollectRemoteFrees() {
+        FreeBlock* block = remote_free_.exchange(nullptr, std::memory_order_acquire);
+        while (block != nullptr) {
+            FreeBlock* next = block->next;
+            block->next = free_[block->cls];
+            free_[block->cls] = block;
+            block = next;
+        }
+    }
+
+    void* Carve(std::size_t size) {
+        // blocks are aligned to their size, at most to the cache line
+        std::size_t align = std::min<std::size_t>(size, 64);
+        auto pos = (reinterpret_cast<std::uintptr_t>(bump_) + align - 1) & ~(align - 1);
+        if (bump_ == nullptr || pos + size > reinterpret_cast<std::uintptr_t>(bump_end_)) {
+            char* region = NewRegion();
+            bump_ = region + sizeof(Region);
+            bump_end_ = region + kRegionSize;
+            pos = (reinterpret_cast<std::uintptr_t>(bump_) + align - 1) & ~(align - 1);
+        }
+        bump_ = reinterpret_cast<char*>(pos + size);
+        return reinterpret_cast<void*>(pos);
+    }
+
+    char* NewRegion() {
+        void* memory = nullptr;
+#ifdef __linux__
+        // over-map to cut an aligned region out of it
+        void* raw = mmap(nullptr, 2 * kRegionSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw != MAP_FAILED) {
+            auto start = reinterpret_cast<std::uintptr_t>(raw);
+            auto aligned = (start + kRegionSize - 1) & ~(kRegionSize - 1);
+            if (aligned > start) {
+                munmap(raw, aligned - start);
+            }
+            std::size_t tail = start + 2 * kRegionSize - (aligned + kRegionSize);
+            if (tail > 0) {
+                munmap(reinterpret_cast<void*>(aligned + kRegionSize), tail);
+            }
+            memory = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+            if (madvise(memory, kRegionSize, MADV_HUGEPAGE) == 0) {
+                huge_page_regions_.fetch_add(1, std::memory_order_relaxed);
+            }
+#endif
+            BindToNumaNode(memory);
+        }
+#endif
+        if (memory == nullptr) {
+            memory = std::aligned_alloc(kRegionSize, kRegionSize);
+            if (memory == nullptr) {
+                throw std::bad_alloc();
+            }
+        }
+        auto* region = static_cast<Region*>(memory);
+        region->arena = this;
+        regions_.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<char*>(memory);
+    }
+
+    static int CurrentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+            return static_cast<int>(node);
+        }
+#endif
+        return 0;
+    }
+
+    // prefer the arena's node, fails harmlessly on kernels without NUMA
+    void BindToNumaNode([[maybe_unused]] void* memory) const {
+#if defined(__linux__) && defined(SYS_mbind)
+        constexpr int kMpolPreferred = 1;
+        constexpr std::size_t kMaxNodes = 8 * sizeof(unsigned long);
+        if (numa_node_ >= 0 && static_cast<std::size_t>(numa_node_) < kMaxNodes) {
+            unsigned long mask = 1UL << numa_node_;
+            syscall(SYS_mbind, memory, kRegionSize, kMpolPreferred, &mask, kMaxNodes, 0);
+        }
+#endif
+    }
+};
+
+// std::allocator replacement drawing from the arena of the allocating thread
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() = default;
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(NodeArena::ForThisThread().Allocate(n * sizeof(T)));
+    }
+    void deallocate(T* ptr, std::size_t n) {
+        NodeArena::Deallocate(ptr, n * sizeof(T));
+    }
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>&) const {
+        return true;
+    }
+};
+
+// Node storage policies of BTree
+struct HeapNodes {
+    template <typename U>
+    using Allocator = std::allocator<U>;
+    struct NodeBase {};
+};
+
+struct HugePageNodes {
+    template <typename U>
+    using Allocator = ArenaAllocator<U>;
+    struct NodeBase {
+        static void* operator new(std::size_t size) {
+            return NodeArena::ForThisThread().Allocate(size);
+        }
+        static void operator delete(void* ptr, std::size_t size) {
+            NodeArena::Deallocate(ptr, size);
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,965 @@
+#ifndef MY_NODE_KEYS
+#define MY_NODE_KEYS
+
+#include<vector>
+#include<memory>
+#include<string_view>
+#include<cstdint>
+#include<cstddef>
+#include<algorithm>
+#include<iterator>
+#include<cstring>
+#include<type_traits>
+#include<new>
+#include<bit>
+#include<limits>
+
+
+// Key storage of a tree node. Every storage keeps its keys sorted and exposes
+// the same small interface, so BTree<T, Order, Keys> never touches the layout.
+template <typename T, typename Alloc = std::allocator<T>>
+class SortedKeys {
+public:
+    using const_iterator = typename std::vector<T, Alloc>::const_iterator;
+
+    std::size_t size() const {
+        return keys_.size();
+    }
+    bool empty() const {
+        return keys_.empty();
+    }
+    const T& operator[](std::size_t idx) const {
+        return keys_[idx];
+    }
+    const_iterator begin() const {
+        return keys_.begin();
+    }
+    const_iterator end() const {
+        return keys_.end();
+    }
+    // index of the first key that is not less than key
+    std::size_t LowerBound(const T& key) const {
+        std::size_t idx = 0;
+        while (idx < keys_.size() && keys_[idx] < key) {
+            ++idx;
+        }
+        return idx;
+    }
+    bool KeyEquals(std::size_t idx, const T& key) const {
+        return keys_[idx] == key;
+    }
+    void Insert(T key) {
+        std::size_t idx = keys_.size();
+        while (idx > 0 && key < keys_[idx - 1]) {
+            --idx;
+        }
+        keys_.insert(keys_.begin() + idx, std::move(key)); // shifts the tail by move
+    }
+    void EraseAt(std::size_t idx) {
+        keys_.erase(keys_.begin() + idx);
+    }
+    T ExtractAt(std::size_t idx) {
+        T key = std::move(keys_[idx]);
+        keys_.erase(keys_.begin() + idx);
+        return key;
+    }
+    // move the count smallest keys to the end of out
+    template <typename Out>
+    void ExtractFront(std::size_t count, Out& out) {
+        out.insert(out.end(), std::make_move_iterator(keys_.begin()), std::make_move_iterator(keys_.begin() + count));
+        keys_.erase(keys_.begin(), keys_.begin() + count);
+    }
+    // put key at idx in place of the old key, which is returned; order must be kept
+    T Replace(std::size_t idx, T key) {
+        std::swap(keys_[idx], key);
+        return key;
+    }
+    // move keys after mid into the empty right, drop them and return keys[mid]
+    T SplitAt(std::size_t mid, SortedKeys& right) {
+        right.keys_.assign(std::make_move_iterator(keys_.begin() + mid + 1), std::make_move_iterator(keys_.end()));
+        T mid_key = std::move(keys_[mid]);
+        keys_.erase(keys_.begin() + mid, keys_.end());
+        return mid_key;
+    }
+    // take every key of other, which all lie on one side of ours
+    void Absorb(SortedKeys&& other) {
+        if (other.keys_.empty()) {
+            return;
+        }
+        auto pos = (keys_.empty() || keys_.back() < other.keys_.front()) ? keys_.end() : keys_.begin();
+        keys_.insert(pos, std::make_move_iterator(other.keys_.begin()), std::make_move_iterator(other.keys_.end()));
+        other.keys_.clear();
+    }
+    // key promoted to the parent on split, any index in [lo, hi] keeps both halves legal
+    std::size_t SeparatorIdx(std::size_t /*lo*/, std::size_t /*hi*/) const {
+        return keys_.size() / 2;
+    }
+private:
+    std::vector<T, Alloc> keys_;
+};
+
+// Base of the storages that rebuild a key on every access. They implement
+// Assign of a sorted vector and get the bulk operations as decode + re-encode,
+// which stays linear in the node size. A storage may hide Decode with a
+// faster one of its own.
+template <typename Keys, typename T>
+class DecodingKeys {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        const_iterator(const Keys* keys, std::size_t idx) : keys_(keys), idx_(idx) {}
+        T operator*() const {
+            return (*keys_)[idx_];
+        }
+        const_iterator& operator++() {
+            ++idx_;
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const {
+            return idx_ == other.idx_;
+        }
+        bool operator!=(const const_iterator& other) const {
+            return idx_ != other.idx_;
+        }
+    private:
+        const Keys* keys_;
+        std::size_t idx_;
+    };
+
+    const_iterator begin() const {
+        return const_iterator(&Self(), 0);
+    }
+    const_iterator end() const {
+        return const_iterator(&Self(), Self().size());
+    }
+    std::vector<T> Decode() const {
+        return std::vector<T>(begin(), end());
+    }
+    T ExtractAt(std::size_t idx) {
+        T key = Self()[idx];
+        Self().EraseAt(idx);
+        return key;
+    }
+    template <typename Out>
+    void ExtractFront(std::size_t count, Out& out) {
+        if (count == 0) {
+            return;
+        }
+        std::vector<T> keys = Self().Decode();
+        out.insert(out.end(), keys.begin(), keys.begin() + count);
+        keys.erase(keys.begin(), keys.begin() + count);
+        Self().Assign(keys);
+    }
+    T Replace(std::size_t idx, T key) {
+        T old_key = Self()[idx];
+        Self().EraseAt(idx);
+        Self().Insert(key);
+        return old_key;
+    }
+    T SplitAt(std::size_t mid, Keys& right) {
+        std::vector<T> keys = Self().Decode();
+        right.Assign(std::vector<T>(keys.begin() + mid + 1, keys.end()));
+        T mid_key = keys[mid];
+        keys.resize(mid);
+        Self().Assign(keys);
+        return mid_key;
+    }
+    void Absorb(Keys&& other) {
+        if (other.size() == 0) {
+            return;
+        }
+        std::vector<T> keys = Self().Decode();
+        std::vector<T> other_keys = other.Decode();
+        if (keys.empty() || keys.back() < other_keys.front()) {
+            keys.insert(keys.end(), other_keys.begin(), other_keys.end());
+        } else {
+            keys.insert(keys.begin(), other_keys.begin(), other_keys.end());
+        }
+        Self().Assign(keys);
+        other.Assign(std::vector<T>());
+    }
+private:
+    const Keys& Self() const {
+        return static_cast<const Keys&>(*this);
+    }
+    Keys& Self() {
+        return static_cast<Keys&>(*this);
+    }
+};
+
+// Prefix-compressed storage for string-like keys. The prefix shared by all keys
+// of the node is kept once, the remaining suffixes are packed back to back in
+// one buffer. Since keys are sorted, the shared prefix is the common prefix of
+// the first and the last key.
+template <typename T>
+class PrefixKeys : public DecodingKeys<PrefixKeys<T>, T> {
+    using Char = typename T::value_type;
+    using View = std::basic_string_view<Char>;
+public:
+    std::size_t size() const {
+        return offsets_.size() - 1;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    T operator[](std::size_t idx) const {
+        T key(prefix_);
+        View suffix = Suffix(idx);
+        key.append(suffix.data(), suffix.size());
+        return key;
+    }
+    const T& Prefix() const {
+        return prefix_;
+    }
+    // bytes held by the node for its keys, excluding the object itself
+    std::size_t KeyBytes() const {
+        return (prefix_.size() + suffixes_.size()) * sizeof(Char) + offsets_.size() * sizeof(std::uint32_t);
+    }
+    std::size_t LowerBound(const T& key) const {
+        View key_view(key);
+        if (key_view.substr(0, prefix_.size()) != View(prefix_)) {
+            // key differs from every stored key inside the prefix
+            return key_view.compare(View(prefix_)) < 0 ? 0 : size();
+        }
+        View rest = key_view.substr(prefix_.size());
+        std::size_t lo = 0;
+        std::size_t hi = size();
+        while (lo < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (Suffix(mid) < rest) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+    bool KeyEquals(std::size_t idx, const T& key) const {
+        View key_view(key);
+        return key_view.size() == prefix_.size() + Suffix(idx).size()
+            && key_view.substr(0, prefix_.size()) == View(prefix_)
+            && key_view.substr(prefix_.size()) == Suffix(idx);
+    }
+    void Insert(const T& key) {
+        View key_view(key);
+        if (empty()) {
+            prefix_ = key;
+            InsertSuffix(0, View());
+            return;
+        }
+        std::size_t common = CommonPrefix(View(prefix_), key_view);
+        if (common < prefix_.size()) {
+            Reprefix(common);
+        }
+        InsertSuffix(LowerBound(key), key_view.substr(prefix_.size()));
+    }
+    void EraseAt(std::size_t idx) {
+        std::uint32_t len = offsets_[idx + 1] - offsets_[idx];
+        suffixes_.erase(offsets_[idx], len);
+        offsets_.erase(offsets_.begin() + idx + 1);
+        for (std::size_t i = idx + 1; i < offsets_.size(); ++i) {
+            offsets_[i] -= len;
+        }
+        if (empty()) {
+            prefix_.clear();
+            suffixes_.clear();
+            return;
+        }
+        // the remaining keys may share a longer prefix now
+        std::size_t extra = CommonPrefix(Suffix(0), Suffix(size() - 1));
+        if (extra > 0) {
+            Reprefix(prefix_.size() + extra);
+        }
+    }
+    void Assign(const std::vector<T>& keys) {
+        prefix_.clear();
+        suffixes_.clear();
+        offsets_.assign(1, 0);
+        if (keys.empty()) {
+            return;
+        }
+        prefix_.assign(keys.front(), 0, CommonPrefix(View(keys.front()), View(keys.back())));
+        for (const T& key : keys) {
+            suffixes_.append(key, prefix_.size(), T::npos);
+            offsets_.push_back(static_cast<std::uint32_t>(suffixes_.size()));
+        }
+    }
+    // suffix truncation: among the legal split points promote the shortest key,
+    // preferring the ones closest to the middle
+    std::size_t SeparatorIdx(std::size_t lo, std::size_t hi) const {
+        std::size_t mid = size() / 2;
+        if (lo > hi || hi >= size()) {
+            return mid;
+        }
+        std::size_t best = std::min(std::max(mid, lo), hi);
+        for (std::size_t i = lo; i <= hi; ++i) {
+            std::size_t len = Suffix(i).size();
+            std::size_t best_len = Suffix(best).size();
+            std::size_t dist = i > mid ? i - mid : mid - i;
+            std::size_t best_dist = best > mid ? best - mid : mid - best;
+            if (len < best_len || (len == best_len && dist < best_dist)) {
+                best = i;
+            }
+        }
+        return best;
+    }
+private:
+    View Suffix(std::size_t idx) const {
+        return View(suffixes_).substr(offsets_[idx], offsets_[idx + 1] - offsets_[idx]);
+    }
+    static std::size_t CommonPrefix(View lhs, View rhs) {
+        std::size_t len = 0;
+        while (len < lhs.size() && len < rhs.size() && lhs[len] == rhs[len]) {
+            ++len;
+        }
+        return len;
+    }
+    void InsertSuffix(std::size_t idx, View suffix) {
+        std::uint32_t len = static_cast<std::uint32_t>(suffix.size());
+        suffixes_.insert(offsets_[idx], suffix.data(), suffix.size());
+        offsets_.insert(offsets_.begin() + idx + 1, offsets_[idx] + len);
+        for (std::size_t i = idx + 2; i < offsets_.size(); ++i) {
+            offsets_[i] += len;
+        }
+    }
+    // re-split every key into prefix_len shared characters and its suffix
+    void Reprefix(std::size_t prefix_len) {
+        T full_prefix(prefix_);
+        if (prefix_len > prefix_.size()) {
+            View grown = Suffix(0).substr(0, prefix_len - prefix_.size());
+            full_prefix.append(grown.data(), grown.size());
+        }
+        T suffixes;
+        std::vector<std::uint32_t> offsets = {0};
+        for (std::size_t i = 0; i < size(); ++i) {
+            if (prefix_len < prefix_.size()) {
+                suffixes.append(prefix_, prefix_len, T::npos);
+                View suffix = Suffix(i);
+                suffixes.append(suffix.data(), suffix.size());
+            } else {
+                View suffix = Suffix(i).substr(prefix_len - prefix_.size());
+                suffixes.append(suffix.data(), suffix.size());
+            }
+            offsets.push_back(static_cast<std::uint32_t>(suffixes.size()));
+        }
+        full_prefix.resize(prefix_len);
+        prefix_ = std::move(full_prefix);
+        suffixes_ = std::move(suffixes);
+        offsets_ = std::move(offsets);
+    }
+
+    T prefix_;
+    T suffixes_;
+    std::vector<std::uint32_t> offsets_ = {0};
+};
+
+// Frame-of-reference storage for integer keys: one base and an unsigned delta per
+// key, packed with the narrowest width (1, 2, 4 or 8 bytes) that covers the range
+// of the node. Search counts the deltas below the target in a branch-free loop
+// which the compiler vectorizes, so the node is never decoded to be searched.
+template <typename T>
+class FrameOfReferenceKeys : public DecodingKeys<FrameOfReferenceKeys<T>, T> {
+    static_assert(std::is_integral<T>::value, "FrameOfReferenceKeys needs integer keys");
+    using Delta = std::make_unsigned_t<T>;
+public:
+    std::size_t size() const {
+        return count_;
+    }
+    bool empty() const {
+        return count_ == 0;
+    }
+    T operator[](std::size_t idx) const {
+        return static_cast<T>(static_cast<Delta>(base_) + static_cast<Delta>(Load(idx)));
+    }
+    std::size_t Width() const {
+        return width_;
+    }
+    // bytes held by the node for its keys, excluding the object itself
+    std::size_t KeyBytes() const {
+        return bytes_.size();
+    }
+    std::size_t LowerBound(const T& key) const {
+        if (empty() || !(base_ < key)) {
+            return 0;
+        }
+        std::uint64_t target = static_cast<Delta>(static_cast<Delta>(key) - static_cast<Delta>(base_));
+        if (target > MaxDelta(width_)) {
+            return size();
+        }
+        switch (width_) {
+            case 1: return CountLess<std::uint8_t>(target);
+            case 2: return CountLess<std::uint16_t>(target);
+            case 4: return CountLess<std::uint32_t>(target);
+            default: return CountLess<std::uint64_t>(target);
+        }
+    }
+    bool KeyEquals(std::size_t idx, const T& key) const {
+        return (*this)[idx] == key;
+    }
+    void Insert(const T& key) {
+        std::size_t idx = LowerBound(key);
+        std::uint64_t delta = static_cast<Delta>(static_cast<Delta>(key) - static_cast<Delta>(base_));
+        if (empty() || key < base_ || delta > MaxDelta(width_)) {
+            // the key falls out of the frame, re-encode the node
+            std::vector<T> keys = this->Decode();
+            keys.insert(keys.begin() + idx, key);
+            Assign(keys);
+            return;
+        }
+        bytes_.insert(bytes_.begin() + idx * width_, width_, 0);
+        ++count_;
+        Store(idx, delta);
+    }
+    void EraseAt(std::size_t idx) {
+        if (idx == 0 || idx + 1 == size()) {
+            // the range shrinks, the node may fit a narrower frame
+            std::vector<T> keys = this->Decode();
+            keys.erase(keys.begin() + idx);
+            Assign(keys);
+            return;
+        }
+        bytes_.erase(bytes_.begin() + idx * width_, bytes_.begin() + (idx + 1) * width_);
+        --count_;
+    }
+    void Assign(const std::vector<T>& keys) {
+        count_ = static_cast<std::uint32_t>(keys.size());
+        if (keys.empty()) {
+            bytes_.clear();
+            bytes_.shrink_to_fit();
+            return;
+        }
+        base_ = keys.front();
+        std::uint64_t range = static_cast<Delta>(static_cast<Delta>(keys.back()) - static_cast<Delta>(base_));
+        width_ = 1;
+        while (range > MaxDelta(width_)) {
+            width_ *= 2;
+        }
+        bytes_.assign(keys.size() * width_, 0);
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            Store(i, static_cast<Delta>(static_cast<Delta>(keys[i]) - static_cast<Delta>(base_)));
+        }
+    }
+    std::size_t SeparatorIdx(std::size_t /*lo*/, std::size_t /*hi*/) const {
+        return size() / 2;
+    }
+private:
+    static std::uint64_t MaxDelta(std::size_t width) {
+        return width >= 8 ? ~std::uint64_t(0) : (std::uint64_t(1) << (8 * width)) - 1;
+    }
+    template <typename U>
+    std::size_t CountLess(std::uint64_t target) const {
+        const std::uint8_t* data = bytes_.data();
+        U bound = static_cast<U>(target);
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < count_; ++i) {
+            U delta;
+            std::memcpy(&delta, data + i * sizeof(U), sizeof(U));
+            count += delta < bound;
+        }
+        return count;
+    }
+    std::uint64_t Load(std::size_t idx) const {
+        const std::uint8_t* data = bytes_.data() + idx * width_;
+        switch (width_) {
+            case 1: return *data;
+            case 2: { std::uint16_t delta; std::memcpy(&delta, data, 2); return delta; }
+            case 4: { std::uint32_t delta; std::memcpy(&delta, data, 4); return delta; }
+            default: { std::uint64_t delta; std::memcpy(&delta, data, 8); return delta; }
+        }
+    }
+    void Store(std::size_t idx, std::uint64_t delta) {
+        std::uint8_t* data = bytes_.data() + idx * width_;
+        switch (width_) {
+            case 1: *data = static_cast<std::uint8_t>(delta); break;
+            case 2: { std::uint16_t value = static_cast<std::uint16_t>(delta); std::memcpy(data, &value, 2); break; }
+            case 4: { std::uint32_t value = static_cast<std::uint32_t>(delta); std::memcpy(data, &value, 4); break; }
+            default: std::memcpy(data, &delta, 8); break;
+        }
+    }
+
+    T base_ = T();
+    std::uint32_t count_ = 0;
+    std::uint8_t width_ = 1;
+    std::vector<std::uint8_t> bytes_;
+};
+
+// Roaring-style storage for dense unsigned ids. The keys of a node live in
+// one of three containers, whichever takes the fewest bytes when the node is
+// built: a sorted array, a bitmap over the 64-bit words the keys span, or
+// runs of consecutive keys. Bitmap words are aligned to multiples of 64 keys,
+// so the bitmaps of any two nodes line up word for word (hybrid_set.h
+// intersects and unites trees that way). Rank and select in a bitmap count
+// the bits of whole words. Single inserts and erases edit the container in
+// place; the choice is redone once a quarter of the node has changed.
+template <typename T>
+class HybridKeys : public DecodingKeys<HybridKeys<T>, T> {
+    static_assert(std::is_unsigned<T>::value, "HybridKeys needs unsigned integer keys");
+public:
+    enum class Container : std::uint8_t { kArray, kBitmap, kRuns };
+
+    std::size_t size() const {
+        return count_;
+    }
+    bool empty() const {
+        return count_ == 0;
+    }
+    T operator[](std::size_t idx) const {
+        switch (kind_) {
+            case Container::kArray: return values_[idx];
+            case Container::kBitmap: return SelectBit(idx);
+            default: return SelectRun(idx);
+        }
+    }
+    Container Kind() const {
+        return kind_;
+    }
+    // bytes held by the node for its keys, excluding the object itself
+    std::size_t KeyBytes() const {
+        return values_.size() * sizeof(T) + words_.size() * sizeof(std::uint64_t) + runs_.size() * sizeof(Run);
+    }
+    std::size_t LowerBound(const T& key) const {
+        switch (kind_) {
+            case Container::kArray: return std::lower_bound(values_.begin(), values_.end(), key) - values_.begin();
+            case Container::kBitmap: return RankBit(key);
+            default: return RankRun(key);
+        }
+    }
+    bool Contains(const T& key) const {
+        switch (kind_) {
+            case Container::kArray: return std::binary_search(values_.begin(), values_.end(), key);
+            case Container::kBitmap: return (Word(key >> 6) >> (key & 63)) & 1;
+            default: {
+                auto run = RunAfter(key);
+                return run != runs_.begin() && key <= std::prev(run)->last;
+            }
+        }
+    }
+    bool KeyEquals(std::size_t idx, const T& key) const {
+        if (kind_ == Container::kArray) {
+            return values_[idx] == key;
+        }
+        return Contains(key) && LowerBound(key) == idx;
+    }
+    // word w of the bitmap, the keys 64 * w to 64 * w + 63; bitmap nodes only
+    std::uint64_t Word(std::uint64_t w) const {
+        return w >= first_word_ && w - first_word_ < words_.size() ? words_[w - first_word_] : 0;
+    }
+    void Insert(const T& key) {
+        if (empty()) {
+            Assign(std::vector<T>{key});
+            return;
+        }
+        switch (kind_) {
+            case Container::kArray:
+                values_.insert(std::lower_bound(values_.begin(), values_.end(), key), key);
+                break;
+            case Container::kBitmap: {
+                std::uint64_t w = key >> 6;
+                std::uint64_t lo = std::min(w, first_word_);
+                std::uint64_t hi = std::max<std::uint64_t>(w, first_word_ + words_.size() - 1);
+                if ((hi - lo + 1) * sizeof(std::uint64_t) > 2 * (count_ + 1) * sizeof(T) + 64) {
+                    // a far key would stretch the bitmap, pick the container again
+                    std::vector<T> keys = Decode();
+                    keys.insert(std::lower_bound(keys.begin(), keys.end(), key), key);
+                    Assign(keys);
+                    return;
+                }
+                if (w < first_word_) {
+                    words_.insert(words_.begin(), first_word_ - w, 0);
+                    first_word_ = w;
+                } else if (w - first_word_ >= words_.size()) {
+                    words_.resize(w - first_word_ + 1, 0);
+                }
+                words_[w - first_word_] |= std::uint64_t(1) << (key & 63);
+                break;
+            }
+            case Container::kRuns:
+                InsertRun(key);
+                break;
+        }
+        ++count_;
+        Changed();
+    }
+    void EraseAt(std::size_t idx) {
+        switch (kind_) {
+            case Container::kArray:
+                values_.erase(values_.begin() + idx);
+                break;
+            case Container::kBitmap: {
+                T key = SelectBit(idx);
+                words_[(key >> 6) - first_word_] &= ~(std::uint64_t(1) << (key & 63));
+                break;
+            }
+            case Container::kRuns:
+                EraseRun(idx);
+                break;
+        }
+        if (--count_ == 0) {
+            Assign(std::vector<T>());
+            return;
+        }
+        Changed();
+    }
+    void Assign(const std::vector<T>& keys) {
+        count_ = static_cast<std::uint32_t>(keys.size());
+        changes_ = 0;
+        first_word_ = 0;
+        values_ = std::vector<T>();
+        words_ = std::vector<std::uint64_t>();
+        runs_ = std::vector<Run>();
+        kind_ = Container::kArray;
+        if (keys.empty()) {
+            return;
+        }
+        std::size_t runs = 1;
+        for (std::size_t i = 1; i < keys.size(); ++i) {
+            runs += keys[i] != keys[i - 1] + 1;
+        }
+        std::uint64_t first_word = keys.front() >> 6;
+        std::size_t array_bytes = keys.size() * sizeof(T);
+        std::size_t bitmap_bytes = ((keys.back() >> 6) - first_word + 1) * sizeof(std::uint64_t);
+        std::size_t run_bytes = runs * sizeof(Run);
+        if (bitmap_bytes < array_bytes && bitmap_bytes <= run_bytes) {
+            kind_ = Container::kBitmap;
+            first_word_ = first_word;
+            words_.assign((keys.back() >> 6) - first_word + 1, 0);
+            for (T key : keys) {
+                words_[(key >> 6) - first_word_] |= std::uint64_t(1) << (key & 63);
+            }
+        } else if (run_bytes < array_bytes) {
+            kind_ = Container::kRuns;
+            runs_.reserve(runs);
+            for (T key : keys) {
+                if (!runs_.empty() && runs_.back().last + 1 == key) {
+                    runs_.back().last = key;
+                } else {
+                    runs_.push_back(Run{key, key});
+                }
+            }
+        } else {
+            values_ = keys;
+        }
+    }
+    std::vector<T> Decode() const {
+        std::vector<T> keys;
+        keys.reserve(count_);
+        ForEachBetween(0, std::numeric_limits<T>::max(), [&keys](T key) {
+            keys.push_back(key);
+        });
+        return keys;
+    }
+    // visit(key) for the keys in [lo, hi], in order
+    template <typename Visit>
+    void ForEachBetween(T lo, T hi, Visit&& visit) const {
+        if (empty() || hi < lo) {
+            return;
+        }
+        switch (kind_) {
+            case Container::kArray:
+                for (auto it = std::lower_bound(values_.begin(), values_.end(), lo); it != values_.end() && *it <= hi; ++it) {
+                    visit(*it);
+                }
+                break;
+            case Container::kBitmap: {
+                std::uint64_t from = std::max<std::uint64_t>(lo >> 6, first_word_);
+                std::uint64_t to = std::min<std::uint64_t>(hi >> 6, first_word_ + words_.size() - 1);
+                for (std::uint64_t w = from; w <= to; ++w) {
+                    std::uint64_t word = words_[w - first_word_] & EdgeMask(w, lo, hi);
+                    for (; word != 0; word &= word - 1) {
+                        visit(static_cast<T>(w * 64 + std::countr_zero(word)));
+                    }
+                }
+                break;
+            }
+            case Container::kRuns: {
+                auto run = RunAfter(lo);
+                if (run != runs_.begin() && std::prev(run)->last >= lo) {
+                    --run;
+                }
+                for (; run != runs_.end() && run->first <= hi; ++run) {
+                    T last = std::min(run->last, hi);
+                    for (T key = std::max(run->first, lo); key < last; ++key) {
+                        visit(key);
+                    }
+                    visit(last);
+                }
+                break;
+            }
+        }
+    }
+    // bits of word w that fall in [lo, hi]
+    static std::uint64_t EdgeMask(std::uint64_t w, T lo, T hi) {
+        std::uint64_t mask = ~std::uint64_t(0);
+        if (w == (lo >> 6)) {
+            mask &= ~std::uint64_t(0) << (lo & 63);
+        }
+        if (w == (hi >> 6)) {
+            mask &= ~std::uint64_t(0) >> (63 - (hi & 63));
+        }
+        return mask;
+    }
+    std::size_t SeparatorIdx(std::size_t /*lo*/, std::size_t /*hi*/) const {
+        return size() / 2;
+    }
+private:
+    struct Run {
+        T first;
+        T last;
+    };
+
+    // first run starting after key
+    typename std::vector<Run>::const_iterator RunAfter(const T& key) const {
+        return std::upper_bound(runs_.begin(), runs_.end(), key, [](const T& k, const Run& run) {
+            return k < run.first;
+        });
+    }
+    std::size_t RankBit(const T& key) const {
+        std::uint64_t w = key >> 6;
+        if (w < first_word_) {
+            return 0;
+        }
+        std::size_t end = static_cast<std::size_t>(std::min<std::uint64_t>(w - first_word_, words_.size()));
+        std::uint64_t below = end < words_.size() ? words_[end] & ((std::uint64_t(1) << (key & 63)) - 1) : 0;
+        std::size_t rank = std::popcount(below);
+        // count whichever side of the word is shorter
+        if (2 * end <= words_.size()) {
+            for (std::size_t i = 0; i < end; ++i) {
+                rank += std::popcount(words_[i]);
+            }
+            return rank;
+        }
+        std::size_t above = 0;
+        for (std::size_t i = end; i < words_.size(); ++i) {
+            above += std::popcount(words_[i]);
+        }
+        return count_ - above + rank;
+    }
+    T SelectBit(std::size_t idx) const {
+        std::size_t w = 0;
+        for (std::size_t bits; idx >= (bits = std::popcount(words_[w])); ++w) {
+            idx -= bits;
+        }
+        std::uint64_t word = words_[w];
+        for (; idx > 0; --idx) {
+            word &= word - 1;
+        }
+        return static_cast<T>((first_word_ + w) * 64 + std::countr_zero(word));
+    }
+    std::size_t RankRun(const T& key) const {
+        std::size_t rank = 0;
+        for (const Run& run : runs_) {
+            if (key <= run.first) {
+                break;
+            }
+            if (key <= run.last) {
+                return rank + (key - run.first);
+            }
+            rank += std::size_t(run.last - run.first) + 1;
+        }
+        return rank;
+    }
+    T SelectRun(std::size_t idx) const {
+        std::size_t r = 0;
+        for (std::size_t len; idx >= (len = std::size_t(runs_[r].last - runs_[r].first) + 1); ++r) {
+            idx -= len;
+        }
+        return static_cast<T>(runs_[r].first + idx);
+    }
+    void InsertRun(const T& key) {
+        auto next = runs_.begin() + (RunAfter(key) - runs_.begin());
+        bool joins_prev = next != runs_.begin() && std::prev(next)->last + 1 == key;
+        bool joins_next = next != runs_.end() && key + 1 == next->first;
+        if (joins_prev && joins_next) {
+            std::prev(next)->last = next->last;
+            runs_.erase(next);
+        } else if (joins_prev) {
+            std::prev(next)->last = key;
+        } else if (joins_next) {
+            next->first = key;
+        } else {
+            runs_.insert(next, Run{key, key});
+        }
+    }
+    void EraseRun(std::size_t idx) {
+        std::size_t r = 0;
+        for (std::size_t len; idx >= (len = std::size_t(runs_[r].last - runs_[r].first) + 1); ++r) {
+            idx -= len;
+        }
+        Run& run = runs_[r];
+        T key = static_cast<T>(run.first + idx);
+        if (run.first == run.last) {
+            runs_.erase(runs_.begin() + r);
+        } else if (key == run.first) {
+            ++run.first;
+        } else if (key == run.last) {
+            --run.last;
+        } else {
+            Run upper{static_cast<T>(key + 1), run.last};
+            run.last = static_cast<T>(key - 1);
+            runs_.insert(runs_.begin() + r + 1, upper);
+        }
+    }
+    void Changed() {
+        if (++changes_ > count_ / 4 + 8) {
+            Assign(Decode());
+        }
+    }
+
+    Container kind_ = Container::kArray;
+    std::uint32_t count_ = 0;
+    // single-key edits since the container was chosen
+    std::uint32_t changes_ = 0;
+    // bitmap: index of the word words_[0]
+    std::uint64_t first_word_ = 0;
+    std::vector<T> values_;
+    std::vector<std::uint64_t> words_;
+    std::vector<Run> runs_;
+};
+
+// Keys stored in the node itself, no separate allocation. Capacity must hold
+// 2 * Order keys: the B*-tree split gathers two full siblings in one node
+// before cutting them into three. Nodes of one or two keys, all of a 2-3
+// tree, are searched with two unrolled comparisons instead of a loop.
+template <typename T, std::size_t Capacity>
+class InlineKeys {
+public:
+    using const_iterator = const T*;
+
+    InlineKeys() = default;
+    InlineKeys(const InlineKeys&) = delete;
+    InlineKeys& operator=(const InlineKeys&) = delete;
+    ~InlineKeys() {
+        Destroy(0);
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    const T& operator[](std::size_t idx) const {
+        return *At(idx);
+    }
+    const_iterator begin() const {
+        return At(0);
+    }
+    const_iterator end() const {
+        return At(size_);
+    }
+    std::size_t LowerBound(const T& key) const {
+        if (size_ <= 2) {
+            // keys are sorted, so the second comparison only holds if the first does
+            return static_cast<std::size_t>(size_ > 0 && *At(0) < key)
+                + static_cast<std::size_t>(size_ > 1 && *At(1) < key);
+        }
+        std::size_t idx = 0;
+        while (idx < size_ && *At(idx) < key) {
+            ++idx;
+        }
+        return idx;
+    }
+    bool KeyEquals(std::size_t idx, const T& key) const {
+        return *At(idx) == key;
+    }
+    void Insert(T key) {
+        std::size_t idx = size_;
+        while (idx > 0 && key < *At(idx - 1)) {
+            --idx;
+        }
+        Relocate(idx, size_, idx + 1);
+        new (At(idx)) T(std::move(key));
+        ++size_;
+    }
+    void EraseAt(std::size_t idx) {
+        At(idx)->~T();
+        Relocate(idx + 1, size_, idx);
+        --size_;
+    }
+    T ExtractAt(std::size_t idx) {
+        T key = std::move(*At(idx));
+        EraseAt(idx);
+        return key;
+    }
+    template <typename Out>
+    void ExtractFront(std::size_t count, Out& out) {
+        for (std::size_t i = 0; i < count; ++i) {
+            out.push_back(std::move(*At(i)));
+            At(i)->~T();
+        }
+        Relocate(count, size_, 0);
+        size_ -= count;
+    }
+    T Replace(std::size_t idx, T key) {
+        std::swap(*At(idx), key);
+        return key;
+    }
+    T SplitAt(std::size_t mid, InlineKeys& right) {
+        for (std::size_t i = mid + 1; i < size_; ++i) {
+            new (right.At(right.size_++)) T(std::move(*At(i)));
+        }
+        T mid_key = std::move(*At(mid));
+        Destroy(mid);
+        return mid_key;
+    }
+    void Absorb(InlineKeys&& other) {
+        if (other.size_ == 0) {
+            return;
+        }
+        std::size_t pos = (size_ == 0 || *At(size_ - 1) < *other.At(0)) ? size_ : 0;
+        Relocate(pos, size_, pos + other.size_);
+        for (std::size_t i = 0; i < other.size_; ++i) {
+            new (At(pos + i)) T(std::move(*other.At(i)));
+        }
+        size_ += other.size_;
+        other.Destroy(0);
+    }
+    std::size_t SeparatorIdx(std::size_t /*lo*/, std::size_t /*hi*/) const {
+        return size_ / 2;
+    }
+private:
+    alignas(T) unsigned char storage_[Capacity * sizeof(T)];
+    std::size_t size_ = 0;
+
+    T* At(std::size_t idx) {
+        return std::launder(reinterpret_cast<T*>(storage_)) + idx;
+    }
+    const T* At(std::size_t idx) const {
+        return std::launder(reinterpret_cast<const T*>(storage_)) + idx;
+    }
+    // destroy the keys from idx on
+    void Destroy(std::size_t idx) {
+        for (std::size_t i = idx; i < size_; ++i) {
+            At(i)->~T();
+        }
+        size_ = std::min(size_, idx);
+    }
+    // move the keys of [first, last) to start at dest, whose slots outside the range are free
+    void Relocate(std::size_t first, std::size_t last, std::size_t dest) {
+        auto move = [this](std::size_t from, std::size_t to) {
+            new (At(to)) T(std::move(*At(from)));
+            At(from)->~T();
+        };
+        if (dest > first) {
+            for (std::size_t i = last; i > first; --i) {
+                move(i - 1, i - 1 + dest - first);
+            }
+        } else {
+            for (std::size_t i = first; i < last; ++i) {
+                move(i, i - first + dest);
+            }
+        }
+    }
+};
+
+// Node keys of a 2-3 tree, see TwoThreeTree
+template <typename T>
+using TwoThreeKeys = InlineKeys<T, 6>;
+
+#endif
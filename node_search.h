@@ -0,0 +1,219 @@
+#ifndef MY_NODE_SEARCH
+#define MY_NODE_SEARCH
+
+#include<algorithm>
+#include<bit>
+#include<cmath>
+#include<cstddef>
+#include<cstdint>
+#include<type_traits>
+
+
+// How a node finds the slot of a key, the Search parameter of BTree. Every
+// strategy keeps a Model per node (empty when it needs none), which the tree
+// refits with Fit whenever the node's keys change, and answers LowerBound
+// from the model and the keys. A model may be stale or useless for the keys
+// at hand; LowerBound must still be exact.
+
+// The keys' own LowerBound, what a node does without a strategy.
+struct ScanSearch {
+    struct Model {};
+
+    template <typename Keys>
+    static void Fit(Model&, const Keys&) {}
+    template <typename Keys, typename T>
+    static std::size_t LowerBound(const Model&, const Keys& keys, const T& key) {
+        return keys.LowerBound(key);
+    }
+    // roughly what one LowerBound costs, for the profiler
+    static std::size_t Comparisons(const Model&, std::size_t quantity) {
+        return std::bit_width(quantity);
+    }
+};
+
+namespace node_search {
+
+template <typename T>
+constexpr bool kNumeric = std::is_arithmetic_v<T>;
+
+// first idx in [lo, hi) whose key is not less than key, hi when none is;
+// Keys is a node's storage or a plain array, also in constant expressions
+template <typename Keys, typename T>
+constexpr std::size_t Scan(const Keys& keys, const T& key, std::size_t lo, std::size_t hi) {
+    while (lo < hi && keys[lo] < key) {
+        ++lo;
+    }
+    return lo;
+}
+
+// Scan for short ranges, halving for long ones
+template <typename Keys, typename T>
+constexpr std::size_t Bisect(const Keys& keys, const T& key, std::size_t lo, std::size_t hi) {
+    while (hi - lo > 8) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return Scan(keys, key, lo, hi);
+}
+
+// LowerBound around a guessed slot: double the step away from the guess until
+// key is bracketed, then halve the bracket
+template <typename Keys, typename T>
+constexpr std::size_t Gallop(const Keys& keys, const T& key, std::size_t guess) {
+    std::size_t quantity = keys.size();
+    std::size_t lo = 0;
+    std::size_t hi = quantity;
+    if (keys[guess] < key) {
+        lo = guess + 1;
+        for (std::size_t step = 1; lo + step <= quantity; step *= 2) {
+            if (!(keys[lo + step - 1] < key)) {
+                hi = lo + step - 1;
+                break;
+            }
+            lo += step;
+        }
+    } else {
+        hi = guess;
+        for (std::size_t step = 1; step <= hi; step *= 2) {
+            if (keys[hi - step] < key) {
+                lo = hi - step + 1;
+                break;
+            }
+            hi -= step;
+        }
+    }
+    return Bisect(keys, key, lo, hi);
+}
+
+}  // namespace node_search
+
+// Interpolation search for numeric keys spread evenly over the node: guess
+// the slot from the first and last key, then gallop from there. Dense ids
+// land on the slot or next to it. Other keys fall back to the keys' search.
+struct InterpolationSearch {
+    struct Model {};
+
+    template <typename Keys>
+    static void Fit(Model&, const Keys&) {}
+    template <typename Keys, typename T>
+    static std::size_t LowerBound(const Model&, const Keys& keys, const T& key) {
+        if constexpr (!node_search::kNumeric<T>) {
+            return keys.LowerBound(key);
+        } else {
+            std::size_t quantity = keys.size();
+            if (quantity <= 4) {
+                return node_search::Scan(keys, key, 0, quantity);
+            }
+            T first = keys[0];
+            T last = keys[quantity - 1];
+            if (!(first < key)) {
+                return 0;
+            }
+            if (last < key) {
+                return quantity;
+            }
+            double fraction = (static_cast<double>(key) - static_cast<double>(first))
+                / (static_cast<double>(last) - static_cast<double>(first));
+            auto guess = static_cast<std::size_t>(fraction * static_cast<double>(quantity - 1));
+            return node_search::Gallop(keys, key, std::min(guess, quantity - 1));
+        }
+    }
+    static std::size_t Comparisons(const Model&, std::size_t quantity) {
+        return 2 + std::bit_width(std::bit_width(quantity));
+    }
+};
+
+// Learned routing: every node fits slot ~ slope * key + intercept over its
+// keys by least squares and records the worst miss of the fit, so LowerBound
+// scans a window of 2 * error + 2 slots around the prediction. One key
+// inserted or erased moves every slot by at most one, so Fit only widens the
+// window then and refits once that has happened a few times. The window is
+// checked against the keys just outside it and a stale model (a key was
+// replaced since the fit) falls back to galloping from the prediction.
+struct LearnedSearch {
+    struct Model {
+        double slope = 0;
+        double intercept = 0;
+        std::uint16_t error = 0;
+        // single-key changes since the fit, each widened error by one
+        std::uint16_t drift = 0;
+        // keys the model is valid for, 0 before the first fit
+        std::uint32_t quantity = 0;
+    };
+
+    template <typename Keys>
+    static void Fit(Model& model, const Keys& keys) {
+        using T = std::decay_t<decltype(keys[0])>;
+        if constexpr (node_search::kNumeric<T>) {
+            std::size_t quantity = keys.size();
+            bool one_key = quantity == model.quantity + 1 || quantity + 1 == model.quantity;
+            // refit once the window has doubled from the fitted one, or grown by 4
+            int fitted = model.error - model.drift;
+            if (one_key && model.quantity != 0 && model.drift < std::max(fitted, 4)) {
+                ++model.error;
+                ++model.drift;
+                model.quantity = static_cast<std::uint32_t>(quantity);
+                return;
+            }
+            model = Model();
+            model.quantity = static_cast<std::uint32_t>(quantity);
+            if (quantity < 2) {
+                return;
+            }
+            // centered on the first key, so large keys keep their precision
+            double base = static_cast<double>(keys[0]);
+            double sum_x = 0;
+            double sum_xx = 0;
+            double sum_xy = 0;
+            for (std::size_t i = 0; i < quantity; ++i) {
+                double x = static_cast<double>(keys[i]) - base;
+                sum_x += x;
+                sum_xx += x * x;
+                sum_xy += x * static_cast<double>(i);
+            }
+            double n = static_cast<double>(quantity);
+            double sum_y = n * (n - 1) / 2;
+            double variance = n * sum_xx - sum_x * sum_x;
+            model.slope = variance > 0 ? (n * sum_xy - sum_x * sum_y) / variance : 0;
+            model.intercept = (sum_y - model.slope * sum_x) / n - model.slope * base;
+            double error = 0;
+            for (std::size_t i = 0; i < quantity; ++i) {
+                error = std::max(error, std::abs(Predict(model, keys[i]) - static_cast<double>(i)));
+            }
+            model.error = static_cast<std::uint16_t>(std::min({std::ceil(error), n, 65535.0}));
+        }
+    }
+    template <typename Keys, typename T>
+    static std::size_t LowerBound(const Model& model, const Keys& keys, const T& key) {
+        if constexpr (!node_search::kNumeric<T>) {
+            return keys.LowerBound(key);
+        } else {
+            std::size_t quantity = keys.size();
+            if (quantity <= 4 || model.quantity != quantity) {
+                return node_search::Scan(keys, key, 0, quantity);
+            }
+            double predicted = std::clamp(Predict(model, key), 0.0, static_cast<double>(quantity - 1));
+            auto guess = static_cast<std::size_t>(predicted);
+            std::size_t lo = guess > model.error ? guess - model.error : 0;
+            std::size_t hi = std::min<std::size_t>(guess + model.error + 2, quantity);
+            if ((lo == 0 || keys[lo - 1] < key) && (hi == quantity || !(keys[hi - 1] < key))) {
+                return node_search::Bisect(keys, key, lo, hi);
+            }
+            return node_search::Gallop(keys, key, guess);
+        }
+    }
+    static std::size_t Comparisons(const Model& model, std::size_t quantity) {
+        return std::min<std::size_t>(2 * model.error + 4, quantity);
+    }
+private:
+    template <typename T>
+    static double Predict(const Model& model, const T& key) {
+        return model.slope * static_cast<double>(key) + model.intercept;
+    }
+};
+
+#endif
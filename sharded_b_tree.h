@@ -0,0 +1,591 @@
+#ifndef MY_SHARDED_B_TREE
+#define MY_SHARDED_B_TREE
+
+#include<vector>
+#include<algorithm>
+#include<memory>
+#include<atomic>
+#include<thread>
+#include<mutex>
+#include<shared_mutex>
+#include<condition_variable>
+#include<future>
+#include<optional>
+#include<iterator>
+#include"b_tree.h"
+
+
+// Range-partitioned front-end over independent BTree shards. Each shard is
+// owned by a worker thread, which is the only one touching its tree: callers
+// route an operation by key into the shard queue and the worker applies what
+// has arrived as one batch. When one shard grows past skew times the average,
+// a background thread asks the workers for their sizes and then for their
+// keys at the ranks of the new split points, then the workers of the shards whose range changed pass the
+// keys that left it to the workers now owning them.
+template <typename T, int Order>
+class ShardedBTree {
+public:
+    // a worker allocates the nodes of its shard from the arena of its thread
+    using Tree = HugePageBTree<T, Order>;
+
+    // shards is the maximum number of shards, sample (if any) picks the first split points
+    explicit ShardedBTree(std::size_t shards, std::vector<T> sample = {}, double skew = 2.0)
+        : max_shards_(std::max<std::size_t>(shards, 1))
+        , skew_(skew) {
+        std::sort(sample.begin(), sample.end());
+        sample.erase(std::unique(sample.begin(), sample.end()), sample.end());
+        splits_ = EvenSplits(sample);
+        for (std::size_t i = 0; i < max_shards_; ++i) {
+            shards_.push_back(std::make_unique<Shard>());
+        }
+        for (auto& shard : shards_) {
+            shard->worker = std::thread(&ShardedBTree::Work, this, shard.get());
+        }
+        rebalancer_ = std::thread(&ShardedBTree::RebalanceOnSkew, this);
+    }
+    ShardedBTree(const ShardedBTree&) = delete;
+    ShardedBTree& operator=(const ShardedBTree&) = delete;
+    ~ShardedBTree() {
+        // the rebalancer first, a rebalance it runs has all its messages queued when it returns
+        {
+            std::lock_guard<std::mutex> lock(rebalance_mutex_);
+            stop_ = true;
+        }
+        rebalance_cv_.notify_all();
+        rebalancer_.join();
+        for (auto& shard : shards_) {
+            {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                shard->stop = true;
+            }
+            shard->wake.notify_one();
+        }
+        for (auto& shard : shards_) {
+            shard->worker.join();
+            // a worker stops once its queue is empty, so only operations queued
+            // while the tree is destroyed can be left
+            while (Link* link = shard->queue.Pop()) {
+                if (link->message) {
+                    delete static_cast<Message*>(link);
+                } else {
+                    delete static_cast<Op*>(link);
+                }
+            }
+        }
+    }
+
+    // Insert and Delete return once queued, Find waits for its answer.
+    // Operations from one thread on one key are applied in order.
+    void Insert(T key) {
+        Submit(new Op(Op::kInsert, std::move(key)));
+    }
+    void Delete(const T& key) {
+        Submit(new Op(Op::kDelete, key));
+    }
+    bool Find(const T& key) {
+        Op* op = new Op(Op::kFind, key);
+        std::future<bool> found = op->found.get_future();
+        Submit(op);
+        return found.get();
+    }
+    // wait until a rebalance asked for has run and every queued operation is applied
+    void Sync() {
+        {
+            std::unique_lock<std::mutex> lock(rebalance_mutex_);
+            rebalance_cv_.wait(lock, [this] {
+                return !rebalance_wanted_ && !rebalance_running_;
+            });
+        }
+        std::shared_lock<std::shared_mutex> lock(routing_);
+        Drain();
+    }
+    std::size_t Size() const {
+        std::size_t size = 0;
+        for (const auto& shard : shards_) {
+            size += shard->size.load(std::memory_order_acquire);
+        }
+        return size;
+    }
+    std::vector<std::size_t> ShardSizes() const {
+        std::vector<std::size_t> sizes;
+        for (const auto& shard : shards_) {
+            sizes.push_back(shard->size.load(std::memory_order_acquire));
+        }
+        return sizes;
+    }
+    // only consistent after Sync with no operations in flight
+    const Tree& ShardTree(std::size_t idx) const {
+        return shards_[idx]->tree;
+    }
+    std::vector<T> SplitPoints() {
+        std::shared_lock<std::shared_mutex> lock(routing_);
+        return splits_;
+    }
+    std::size_t Rebalances() const {
+        return rebalances_.load(std::memory_order_relaxed);
+    }
+    // redistribute keys evenly over the shards and wait until they have moved
+    void Rebalance() {
+        Sync();
+        {
+            std::unique_lock<std::mutex> lock(rebalance_mutex_);
+            rebalance_cv_.wait(lock, [this] {
+                return !rebalance_running_;
+            });
+            rebalance_running_ = true;
+        }
+        Redistribute();
+        {
+            std::lock_guard<std::mutex> lock(rebalance_mutex_);
+            rebalance_running_ = false;
+        }
+        rebalance_cv_.notify_all();
+        Sync();
+    }
+private:
+    struct Link {
+        std::atomic<Link*> next{nullptr};
+        bool message = false;
+    };
+    struct Op : Link {
+        enum Kind { kInsert, kDelete, kFind };
+        Op(Kind op_kind, T op_key) : kind(op_kind), key(std::move(op_key)) {}
+        Kind kind;
+        T key;
+        std::promise<bool> found;
+    };
+    // Rebalancing orders for a worker, queued behind the operations before them.
+    // kSample tells the shard's size and copies out the keys at ranks, scaled
+    // from a shard of of keys to that size. kExtract removes the keys outside [low, high) (all of
+    // them if empty) and passes them, by splits, to the adopts of the shards
+    // taking them over, then keeps the promise handed_over[j] of each.
+    // kAdopt waits for its arrived future, then inserts keys.
+    struct Message : Link {
+        enum Kind { kSample, kExtract, kAdopt };
+        explicit Message(Kind message_kind) : kind(message_kind) {
+            this->message = true;
+        }
+        Kind kind;
+        std::vector<std::size_t> ranks;
+        std::size_t of = 0;
+        std::size_t size = 0;
+        std::optional<T> low;
+        std::optional<T> high;
+        bool empty = false;
+        std::vector<T> splits;
+        std::vector<Message*> adopts;
+        std::vector<std::promise<void>> handed_over;
+        std::future<void> arrived;
+        std::vector<T> keys;
+        std::promise<void> done;
+    };
+
+    // Vyukov's intrusive multi-producer single-consumer queue
+    class OpQueue {
+    public:
+        OpQueue() : head_(&stub_), tail_(&stub_) {}
+        void Push(Link* op) {
+            op->next.store(nullptr, std::memory_order_relaxed);
+            Link* prev = head_.exchange(op, std::memory_order_acq_rel);
+            prev->next.store(op, std::memory_order_release);
+        }
+        // nullptr when empty or a push is half done
+        Link* Pop() {
+            Link* tail = tail_;
+            Link* next = tail->next.load(std::memory_order_acquire);
+            if (tail == &stub_) {
+                if (next == nullptr) {
+                    return nullptr;
+                }
+                tail_ = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next != nullptr) {
+                tail_ = next;
+                return tail;
+            }
+            if (tail != head_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            Push(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                tail_ = next;
+                return tail;
+            }
+            return nullptr;
+        }
+    private:
+        Link stub_;
+        std::atomic<Link*> head_;
+        Link* tail_;
+    };
+
+    struct Shard {
+        Tree tree;
+        OpQueue queue;
+        // queued and not yet applied
+        std::atomic<std::size_t> pending{0};
+        std::atomic<std::size_t> size{0};
+        std::atomic<bool> sleeping{false};
+        bool stop = false;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::thread worker;
+    };
+
+    static constexpr std::size_t kMaxBatch = 256;
+    // submitted operations between two skew checks
+    static constexpr std::size_t kSkewCheckPeriod = 1024;
+
+    std::size_t max_shards_;
+    double skew_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<T> splits_;
+    std::shared_mutex routing_;
+    std::atomic<std::size_t> submitted_{0};
+    std::atomic<std::size_t> rebalances_{0};
+    // the skew check asks rebalancer_ for a rebalance, which runs one at a
+    // time with those of Rebalance(); the flags are guarded by rebalance_mutex_
+    std::mutex rebalance_mutex_;
+    std::condition_variable rebalance_cv_;
+    bool rebalance_wanted_ = false;
+    bool rebalance_running_ = false;
+    bool stop_ = false;
+    std::thread rebalancer_;
+
+    // at most max_shards_ - 1 evenly spaced points of sorted distinct keys
+    std::vector<T> EvenSplits(const std::vector<T>& keys) const {
+        std::vector<T> splits;
+        std::size_t parts = std::min(max_shards_, keys.size());
+        for (std::size_t i = 1; i < parts; ++i) {
+            splits.push_back(keys[i * keys.size() / parts]);
+        }
+        return splits;
+    }
+
+    // Callers are the only rebalance running. The shard sizes, once the
+    // operations queued before are applied, give the rank of every new split
+    // point and the shard holding it, whose worker then copies out the key
+    // there; no lock is held meanwhile. Under routing_ the shards whose range
+    // changed are sent an extract, and each shard an adopt per shard it takes
+    // keys from; operations routed afterwards queue behind them, and so run
+    // after the keys have arrived.
+    void Redistribute() {
+        std::vector<std::unique_ptr<Message>> samples(shards_.size());
+        for (auto& sample : samples) {
+            sample = std::make_unique<Message>(Message::kSample);
+        }
+        Exchange(samples);
+        std::size_t total = 0;
+        for (const auto& sample : samples) {
+            total += sample->size;
+        }
+        std::size_t parts = std::min(max_shards_, total);
+        std::size_t idx = 0;
+        std::size_t before = 0;
+        for (std::size_t i = 1; i < parts; ++i) {
+            std::size_t rank = i * total / parts;
+            while (rank >= before + samples[idx]->size) {
+                before += samples[idx++]->size;
+            }
+            samples[idx]->ranks.push_back(rank - before);
+        }
+        for (auto& sample : samples) {
+            if (sample->ranks.empty()) {
+                sample = nullptr;
+            } else {
+                sample->of = sample->size;
+                sample->done = std::promise<void>();
+            }
+        }
+        Exchange(samples);
+        std::vector<T> splits;
+        for (const auto& sample : samples) {
+            if (sample) {
+                splits.insert(splits.end(), sample->keys.begin(), sample->keys.end());
+            }
+        }
+        // keys that changed meanwhile may leave them out of order
+        std::sort(splits.begin(), splits.end());
+        splits.erase(std::unique(splits.begin(), splits.end()), splits.end());
+
+        std::unique_lock<std::shared_mutex> lock(routing_);
+        std::vector<bool> changed(shards_.size());
+        for (std::size_t i = 0; i < shards_.size(); ++i) {
+            changed[i] = Bound(splits_, i, false) != Bound(splits, i, false)
+                || Bound(splits_, i, true) != Bound(splits, i, true)
+                || (i > splits_.size()) != (i > splits.size());
+        }
+        if (std::find(changed.begin(), changed.end(), true) == changed.end()) {
+            return;
+        }
+        for (std::size_t i = 0; i < shards_.size(); ++i) {
+            if (!changed[i]) {
+                continue;
+            }
+            Message* extract = new Message(Message::kExtract);
+            extract->low = Bound(splits, i, false);
+            extract->high = Bound(splits, i, true);
+            extract->empty = i > splits.size();
+            extract->splits = splits;
+            extract->adopts.assign(shards_.size(), nullptr);
+            extract->handed_over.resize(shards_.size());
+            for (std::size_t j = 0; j < shards_.size(); ++j) {
+                if (changed[j] && j != i) {
+                    extract->adopts[j] = new Message(Message::kAdopt);
+                    extract->adopts[j]->arrived = extract->handed_over[j].get_future();
+                }
+            }
+            // before the adopts, which wait for other extracts but never the other way round
+            std::vector<Message*> adopts = extract->adopts;
+            Push(shards_[i].get(), extract);
+            for (std::size_t j = 0; j < shards_.size(); ++j) {
+                if (adopts[j] != nullptr) {
+                    Push(shards_[j].get(), adopts[j]);
+                }
+            }
+        }
+        splits_ = std::move(splits);
+        rebalances_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // lower (or upper) end of the range of shard idx under splits, none at the edges
+    static std::optional<T> Bound(const std::vector<T>& splits, std::size_t idx, bool upper) {
+        if (upper) {
+            return idx < splits.size() ? std::optional<T>(splits[idx]) : std::nullopt;
+        }
+        return idx > 0 && idx <= splits.size() ? std::optional<T>(splits[idx - 1]) : std::nullopt;
+    }
+
+    // send messages[i] (if any) to shard i and wait until they are handled
+    void Exchange(const std::vector<std::unique_ptr<Message>>& messages) {
+        std::vector<std::future<void>> done(shards_.size());
+        for (std::size_t i = 0; i < shards_.size(); ++i) {
+            if (messages[i]) {
+                done[i] = messages[i]->done.get_future();
+                Push(shards_[i].get(), messages[i].get());
+            }
+        }
+        for (std::size_t i = 0; i < shards_.size(); ++i) {
+            if (messages[i]) {
+                done[i].get();
+            }
+        }
+    }
+
+    void Push(Shard* shard, Link* link) {
+        shard->pending.fetch_add(1, std::memory_order_seq_cst);
+        shard->queue.Push(link);
+        if (shard->sleeping.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> wake_lock(shard->mutex);
+            shard->wake.notify_one();
+        }
+    }
+
+    void Submit(Op* op) {
+        {
+            std::shared_lock<std::shared_mutex> lock(routing_);
+            std::size_t idx = std::upper_bound(splits_.begin(), splits_.end(), op->key) - splits_.begin();
+            Push(shards_[idx].get(), op);
+        }
+        if (submitted_.fetch_add(1, std::memory_order_relaxed) % kSkewCheckPeriod == 0 && Skewed()) {
+            {
+                std::lock_guard<std::mutex> lock(rebalance_mutex_);
+                rebalance_wanted_ = true;
+            }
+            rebalance_cv_.notify_all();
+        }
+    }
+
+    // runs the rebalances the skew check asks for, off the callers' path
+    void RebalanceOnSkew() {
+        std::unique_lock<std::mutex> lock(rebalance_mutex_);
+        while (true) {
+            rebalance_cv_.wait(lock, [this] {
+                return stop_ || (rebalance_wanted_ && !rebalance_running_);
+            });
+            if (stop_) {
+                return;
+            }
+            rebalance_wanted_ = false;
+            rebalance_running_ = true;
+            lock.unlock();
+            // the last rebalance may have fixed it already
+            if (Skewed()) {
+                Redistribute();
+            }
+            lock.lock();
+            rebalance_running_ = false;
+            rebalance_cv_.notify_all();
+        }
+    }
+
+    bool Skewed() const {
+        std::size_t total = 0;
+        std::size_t largest = 0;
+        for (const auto& shard : shards_) {
+            // count queued operations as inserts, workers may lag far behind
+            std::size_t size = shard->size.load(std::memory_order_relaxed)
+                + shard->pending.load(std::memory_order_relaxed);
+            total += size;
+            largest = std::max(largest, size);
+        }
+        return max_shards_ > 1 && total >= kSkewCheckPeriod && largest > skew_ * total / max_shards_;
+    }
+
+    // callers hold routing_, so nothing new is queued meanwhile
+    void Drain() {
+        for (auto& shard : shards_) {
+            while (shard->pending.load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void Work(Shard* shard) {
+        std::vector<Op*> batch;
+        while (true) {
+            Message* message = nullptr;
+            if (shard->pending.load(std::memory_order_seq_cst) == 0) {
+                std::unique_lock<std::mutex> lock(shard->mutex);
+                shard->sleeping.store(true, std::memory_order_seq_cst);
+                shard->wake.wait(lock, [shard] {
+                    return shard->stop || shard->pending.load(std::memory_order_seq_cst) != 0;
+                });
+                shard->sleeping.store(false, std::memory_order_relaxed);
+                // the adopts of other shards may wait for a message still queued here
+                if (shard->stop && shard->pending.load(std::memory_order_seq_cst) == 0) {
+                    return;
+                }
+            }
+            // a message ends the batch, the operations queued before it go first
+            while (batch.size() < kMaxBatch) {
+                Link* link = shard->queue.Pop();
+                if (link == nullptr) {
+                    break;
+                }
+                if (link->message) {
+                    message = static_cast<Message*>(link);
+                    break;
+                }
+                batch.push_back(static_cast<Op*>(link));
+            }
+            if (batch.empty() && message == nullptr) {
+                // a producer is between counting and linking its operation
+                std::this_thread::yield();
+                continue;
+            }
+            std::size_t applied = batch.size() + (message != nullptr);
+            Apply(shard, batch);
+            if (message != nullptr) {
+                Handle(shard, message);
+            }
+            shard->pending.fetch_sub(applied, std::memory_order_release);
+            batch.clear();
+        }
+    }
+
+    // operations on different keys commute, sorting keeps those on one key in order
+    // and lets the finger walk the tree once
+    void Apply(Shard* shard, std::vector<Op*>& batch) {
+        std::stable_sort(batch.begin(), batch.end(), [](const Op* a, const Op* b) {
+            return a->key < b->key;
+        });
+        typename Tree::Cursor hint;
+        for (Op* op : batch) {
+            switch (op->kind) {
+            case Op::kInsert:
+                shard->tree.Insert(hint, op->key);
+                break;
+            case Op::kDelete:
+                shard->tree.Delete(op->key);
+                break;
+            case Op::kFind:
+                op->found.set_value(shard->tree.Find(hint, op->key));
+                break;
+            }
+        }
+        shard->size.store(shard->tree.Size(), std::memory_order_release);
+        for (Op* op : batch) {
+            delete op;
+        }
+    }
+
+    void Handle(Shard* shard, Message* message) {
+        Tree& tree = shard->tree;
+        switch (message->kind) {
+        case Message::kSample:
+            message->size = tree.Size();
+            if (const T* min = tree.Min(); min != nullptr && !message->ranks.empty()) {
+                // the shard may have changed since the ranks were taken
+                std::size_t size = tree.Size();
+                std::size_t idx = 0;
+                std::size_t rank = 0;
+                tree.ForEachInRange(*min, *tree.Max(), [message, size, &idx, &rank](const T& key) {
+                    while (idx < message->ranks.size() && message->ranks[idx] * size / message->of == rank) {
+                        message->keys.push_back(key);
+                        ++idx;
+                    }
+                    ++rank;
+                });
+            }
+            break;
+        case Message::kExtract:
+            if (const T* min = tree.Min()) {
+                T max = *tree.Max();
+                auto leaves = [message](const T& key) {
+                    if (message->empty || (message->low && key < *message->low)
+                        || (message->high && !(key < *message->high))) {
+                        message->keys.push_back(key);
+                    }
+                };
+                if (message->empty) {
+                    tree.ForEachInRange(*min, max, leaves);
+                } else {
+                    if (message->low) {
+                        tree.ForEachInRange(*min, *message->low, leaves);
+                    }
+                    if (message->high) {
+                        tree.ForEachInRange(*message->high, max, leaves);
+                    }
+                }
+                for (const T& key : message->keys) {
+                    tree.Delete(key);
+                }
+            }
+            for (T& key : message->keys) {
+                std::size_t idx = std::upper_bound(message->splits.begin(), message->splits.end(), key)
+                    - message->splits.begin();
+                message->adopts[idx]->keys.push_back(std::move(key));
+            }
+            break;
+        case Message::kAdopt: {
+            message->arrived.wait();
+            typename Tree::Cursor hint;
+            for (T& key : message->keys) {
+                tree.Insert(hint, std::move(key));
+            }
+            break;
+        }
+        }
+        shard->size.store(tree.Size(), std::memory_order_release);
+        if (message->kind == Message::kExtract) {
+            // an adopt may be handled and freed as soon as its keys are handed over
+            for (std::size_t j = 0; j < message->adopts.size(); ++j) {
+                if (message->adopts[j] != nullptr) {
+                    message->handed_over[j].set_value();
+                }
+            }
+            delete message;
+        } else if (message->kind == Message::kAdopt) {
+            delete message;
+        } else {
+            // the caller owns the message again once done is set
+            message->done.set_value();
+        }
+    }
+};
+
+#endif
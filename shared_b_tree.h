@@ -0,0 +1,629 @@
+#ifndef MY_SHARED_B_TREE
+#define MY_SHARED_B_TREE
+
+#include<algorithm>
+#include<atomic>
+#include<cerrno>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<new>
+#include<stdexcept>
+#include<string>
+#include<system_error>
+#include<thread>
+#include<type_traits>
+#include<utility>
+#include<fcntl.h>
+#include<sys/file.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+
+// B-tree kept in a POSIX shared memory segment, so the processes of a host
+// map one copy of it instead of holding one each. Children are linked by
+// their offset from the start of the segment, which is valid in every
+// mapping. One process at a time is the writer (it holds an flock on the
+// segment, released when it exits); each of its updates is bracketed by a
+// sequence counter that is odd while the update is in flight. Readers map
+// the segment read-only, search it in place and then check the counter: a
+// search that overlapped an update is retried, up to a deadline after
+// which a writer that died inside an update is assumed. Every link and count read is
+// bounds-checked first, so a reader racing the writer never leaves the
+// segment. An update first copies each node it changes to an undo log at
+// the end of the segment, and the next writer to open a segment left
+// inside an update puts them back. Keys are copied as bytes. The segment
+// has the size given at creation and Insert throws std::bad_alloc, before
+// changing anything, when the nodes it may need and their log do not fit.
+template <typename T, int Order>
+class SharedBTree {
+    static_assert(std::is_trivially_copyable_v<T>, "keys of a shared tree must be trivially copyable");
+    static_assert(Order >= 4, "SharedBTree needs Order >= 4");
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the sequence counter must work across processes");
+
+    static constexpr int kMaxKeys = Order - 1;
+    // a split leaves both halves at least this full, a merge of two stays within kMaxKeys
+    static constexpr int kMinKeys = (kMaxKeys - 1) / 2;
+    static constexpr int kMaxHeight = 64;
+    static constexpr std::uint64_t kMagic = 0x5348415245444254;  // "SHAREDBT"
+    static constexpr std::chrono::milliseconds kPatience{1000};
+
+    // the header fields an update may change, as they were before it
+    struct Snapshot {
+        std::uint64_t root;
+        std::uint64_t size;
+        std::int64_t height;
+        std::uint64_t bump;
+        std::uint64_t free_leaves;
+        std::uint64_t free_internals;
+        std::uint64_t free_leaf_count;
+        std::uint64_t free_internal_count;
+    };
+    struct Header {
+        std::uint64_t magic;
+        std::uint32_t key_size;
+        std::uint32_t order;
+        std::uint64_t capacity;
+        alignas(64) std::atomic<std::uint64_t> sequence;
+        std::atomic<std::uint64_t> root;
+        std::atomic<std::uint64_t> size;
+        std::atomic<std::int64_t> height;
+        // writer only
+        std::uint64_t bump;
+        std::uint64_t free_leaves;
+        std::uint64_t free_internals;
+        std::uint64_t free_leaf_count;
+        std::uint64_t free_internal_count;
+        // of the update in flight, see Update
+        Snapshot before;
+        std::atomic<std::uint64_t> undo_count;
+    };
+    struct Node {
+        std::uint32_t count;
+        T keys[kMaxKeys];
+    };
+    struct InternalNode : Node {
+        std::uint64_t childs[Order];
+    };
+    static constexpr std::size_t kAlign = std::max<std::size_t>(alignof(InternalNode), 8);
+    // a node as it was before the update in flight changed it
+    struct Undo {
+        std::uint64_t offset;
+        std::uint64_t bytes;
+        alignas(kAlign) unsigned char image[sizeof(InternalNode)];
+    };
+public:
+    // creates the segment name with room for bytes and opens it as the
+    // writer; an existing segment of that name is replaced only if asked,
+    // otherwise Create throws std::system_error with EEXIST
+    static SharedBTree Create(const std::string& name, std::size_t bytes, bool replace = false) {
+        if (replace) {
+            shm_unlink(name.c_str());
+        }
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        }
+        SharedBTree tree(fd, true);
+        bytes = std::max(bytes, AlignUp(sizeof(Header)) + sizeof(InternalNode));
+        // the segment is ours until it is set up, a failure removes it again
+        if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            int error = errno;
+            shm_unlink(name.c_str());
+            throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+        }
+        try {
+            tree.Map(bytes);
+        } catch (...) {
+            shm_unlink(name.c_str());
+            throw;
+        }
+        Header* header = new (tree.base_) Header();
+        header->magic = kMagic;
+        header->key_size = sizeof(T);
+        header->order = Order;
+        header->capacity = bytes;
+        header->bump = AlignUp(sizeof(Header));
+        return tree;
+    }
+    // maps an existing segment, read-only or as the writer; throws if the
+    // segment holds another kind of tree or, for a writer, if another
+    // process writes it. A writer opening a segment whose last writer died
+    // inside an update rolls that update back, which lets readers in again.
+    static SharedBTree Open(const std::string& name, bool writer = false) {
+        int fd = shm_open(name.c_str(), writer ? O_RDWR : O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+        }
+        SharedBTree tree(fd, writer);
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            throw std::system_error(errno, std::generic_category(), "fstat " + name);
+        }
+        if (static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+            throw std::runtime_error("not a shared tree: " + name);
+        }
+        tree.Map(static_cast<std::size_t>(st.st_size));
+        const Header* header = tree.header();
+        if (header->magic != kMagic || header->key_size != sizeof(T) || header->order != Order
+            || header->capacity != static_cast<std::uint64_t>(st.st_size)) {
+            throw std::runtime_error("shared tree of another type: " + name);
+        }
+        if (writer && (header->sequence.load(std::memory_order_acquire) & 1) != 0) {
+            tree.Rollback(name);
+        }
+        return tree;
+    }
+    static void Unlink(const std::string& name) {
+        shm_unlink(name.c_str());
+    }
+
+    SharedBTree(SharedBTree&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1))
+        , writer_(other.writer_)
+        , base_(std::exchange(other.base_, nullptr))
+        , bytes_(std::exchange(other.bytes_, 0))
+        , retries_(other.retries_.load(std::memory_order_relaxed)) {}
+    SharedBTree& operator=(SharedBTree&& other) noexcept {
+        if (this != &other) {
+            Release();
+            fd_ = std::exchange(other.fd_, -1);
+            writer_ = other.writer_;
+            base_ = std::exchange(other.base_, nullptr);
+            bytes_ = std::exchange(other.bytes_, 0);
+            retries_.store(other.retries_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        return *this;
+    }
+    ~SharedBTree() {
+        Release();
+    }
+
+    // Searches the mapped nodes, no copy, no lock. Waits out an update in
+    // flight and retries when one started during the search, for at most
+    // patience: past it Find throws std::system_error with ETIMEDOUT, as the
+    // writer most likely died inside an update.
+    bool Find(const T& key, std::chrono::milliseconds patience = kPatience) const {
+        const Header* header = this->header();
+        auto deadline = std::chrono::steady_clock::now() + patience;
+        while (true) {
+            std::uint64_t begin = header->sequence.load(std::memory_order_acquire);
+            if ((begin & 1) == 0) {
+                int found = Search(key);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (found >= 0 && header->sequence.load(std::memory_order_relaxed) == begin) {
+                    return found == 1;
+                }
+            }
+            retries_.fetch_add(1, std::memory_order_relaxed);
+            if (std::chrono::steady_clock::now() >= deadline) {
+                throw std::system_error(ETIMEDOUT, std::generic_category(), "shared tree stuck inside an update");
+            }
+            std::this_thread::yield();
+        }
+    }
+    // writer only
+    void Insert(const T& key) {
+        RequireWriter();
+        if (Search(key) == 1) {
+            return;
+        }
+        Reserve();
+        Update update(*this);
+        Header* header = this->header();
+        std::int64_t height = header->height.load(std::memory_order_relaxed);
+        if (header->root.load(std::memory_order_relaxed) == 0) {
+            header->root.store(NewNode(true), std::memory_order_relaxed);
+            height = 0;
+        } else if (At(header->root.load(std::memory_order_relaxed))->count == kMaxKeys) {
+            std::uint64_t new_root = NewNode(false);
+            AsInternal(At(new_root))->childs[0] = header->root.load(std::memory_order_relaxed);
+            SplitChild(AsInternal(At(new_root)), 0, height);
+            header->root.store(new_root, std::memory_order_relaxed);
+            ++height;
+        }
+        header->height.store(height, std::memory_order_relaxed);
+        // full nodes are split on the way down, so the leaf has room
+        Node* node = At(header->root.load(std::memory_order_relaxed));
+        for (; height > 0; --height) {
+            InternalNode* internal = AsInternal(node);
+            std::size_t idx = Rank(node, key);
+            if (At(internal->childs[idx])->count == kMaxKeys) {
+                SplitChild(internal, idx, height - 1);
+                if (node->keys[idx] < key) {
+                    ++idx;
+                }
+            }
+            node = At(internal->childs[idx]);
+        }
+        std::size_t idx = Rank(node, key);
+        Touch(node, true);
+        std::memmove(node->keys + idx + 1, node->keys + idx, (node->count - idx) * sizeof(T));
+        node->keys[idx] = key;
+        ++node->count;
+        header->size.store(header->size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    // writer only
+    void Delete(const T& key) {
+        RequireWriter();
+        if (Search(key) != 1) {
+            return;
+        }
+        Update update(*this);
+        Header* header = this->header();
+        std::int64_t height = header->height.load(std::memory_order_relaxed);
+        std::uint64_t root = header->root.load(std::memory_order_relaxed);
+        DeleteFrom(At(root), height, key);
+        if (At(root)->count == 0) {
+            // the root lost its last key to a merge or to the delete
+            std::uint64_t next = height > 0 ? AsInternal(At(root))->childs[0] : 0;
+            FreeNode(root, height == 0);
+            header->root.store(next, std::memory_order_relaxed);
+            header->height.store(height > 0 ? height - 1 : 0, std::memory_order_relaxed);
+        }
+        header->size.store(header->size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    }
+    std::size_t Size() const {
+        return header()->size.load(std::memory_order_acquire);
+    }
+    int Height() const {
+        return static_cast<int>(header()->height.load(std::memory_order_acquire));
+    }
+    bool IsWriter() const {
+        return writer_;
+    }
+    // bytes of the segment, and those handed out to nodes so far
+    std::size_t Capacity() const {
+        return bytes_;
+    }
+    std::size_t UsedBytes() const {
+        return header()->bump;
+    }
+    // searches of this handle that overlapped an update and ran again
+    std::size_t Retries() const {
+        return retries_.load(std::memory_order_relaxed);
+    }
+private:
+    // makes the sequence odd for the lifetime of an update, after saving the
+    // header fields for Rollback and emptying the undo log
+    class Update {
+    public:
+        explicit Update(SharedBTree& tree) : header_(tree.header()) {
+            header_->before = {header_->root.load(std::memory_order_relaxed),
+                               header_->size.load(std::memory_order_relaxed),
+                               header_->height.load(std::memory_order_relaxed),
+                               header_->bump,
+                               header_->free_leaves,
+                               header_->free_internals,
+                               header_->free_leaf_count,
+                               header_->free_internal_count};
+            header_->undo_count.store(0, std::memory_order_relaxed);
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            std::uint64_t sequence = header_->sequence.load(std::memory_order_relaxed);
+            header_->sequence.store(sequence + 1, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        ~Update() {
+            header_->sequence.store(header_->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    private:
+        Header* header_;
+    };
+
+    int fd_ = -1;
+    bool writer_ = false;
+    char* base_ = nullptr;
+    std::size_t bytes_ = 0;
+    mutable std::atomic<std::size_t> retries_{0};
+
+    SharedBTree(int fd, bool writer) : fd_(fd), writer_(writer) {
+        if (writer && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            int error = errno;
+            close(fd);
+            fd_ = -1;
+            throw std::system_error(error, std::generic_category(), "another process writes the shared tree");
+        }
+    }
+    void Map(std::size_t bytes) {
+        void* memory = mmap(nullptr, bytes, writer_ ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+        if (memory == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        }
+        base_ = static_cast<char*>(memory);
+        bytes_ = bytes;
+    }
+    void Release() {
+        if (base_ != nullptr) {
+            munmap(base_, bytes_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            close(fd_);  // drops the writer's flock
+            fd_ = -1;
+        }
+    }
+    void RequireWriter() const {
+        if (!writer_) {
+            throw std::logic_error("shared tree opened read-only");
+        }
+    }
+
+    static constexpr std::size_t AlignUp(std::size_t bytes) {
+        return (bytes + kAlign - 1) / kAlign * kAlign;
+    }
+    static constexpr std::size_t NodeBytes(bool leaf) {
+        return AlignUp(leaf ? sizeof(Node) : sizeof(InternalNode));
+    }
+    Header* header() const {
+        return reinterpret_cast<Header*>(base_);
+    }
+    Node* At(std::uint64_t offset) const {
+        return reinterpret_cast<Node*>(base_ + offset);
+    }
+    static InternalNode* AsInternal(Node* node) {
+        return static_cast<InternalNode*>(node);
+    }
+    // the node at offset if it lies inside the segment, for readers racing the writer
+    const Node* Checked(std::uint64_t offset, bool leaf) const {
+        if (offset < sizeof(Header) || offset % kAlign != 0 || offset > bytes_ || bytes_ - offset < NodeBytes(leaf)) {
+            return nullptr;
+        }
+        return At(offset);
+    }
+    static std::size_t Rank(const Node* node, const T& key) {
+        return std::lower_bound(node->keys, node->keys + node->count, key) - node->keys;
+    }
+    // 1 found, 0 not found, -1 the nodes were seen inside an update
+    int Search(const T& key) const {
+        const Header* header = this->header();
+        std::uint64_t offset = header->root.load(std::memory_order_relaxed);
+        std::int64_t height = header->height.load(std::memory_order_relaxed);
+        if (offset == 0) {
+            return 0;
+        }
+        if (height < 0 || height > kMaxHeight) {
+            return -1;
+        }
+        for (;; --height) {
+            const Node* node = Checked(offset, height == 0);
+            if (node == nullptr) {
+                return -1;
+            }
+            std::uint32_t count = node->count;
+            if (count > kMaxKeys) {
+                return -1;
+            }
+            const T* end = node->keys + count;
+            const T* slot = std::lower_bound(node->keys, end, key);
+            if (slot != end && *slot == key) {
+                return 1;
+            }
+            if (height == 0) {
+                return 0;
+            }
+            offset = static_cast<const InternalNode*>(node)->childs[slot - node->keys];
+        }
+    }
+
+    // an update saves at most three nodes a level, and a few more for a new root
+    static constexpr std::uint64_t UndoBytes(std::uint64_t height) {
+        return 3 * (height + 4) * sizeof(Undo);
+    }
+    Undo* UndoAt(std::uint64_t idx) const {
+        return reinterpret_cast<Undo*>(base_ + bytes_ / alignof(Undo) * alignof(Undo)) - (idx + 1);
+    }
+    // save node before the update in flight first changes it
+    void Touch(const Node* node, bool leaf) {
+        Header* header = this->header();
+        std::uint64_t count = header->undo_count.load(std::memory_order_relaxed);
+        Undo* undo = UndoAt(count);
+        undo->offset = static_cast<std::uint64_t>(reinterpret_cast<const char*>(node) - base_);
+        undo->bytes = NodeBytes(leaf);
+        std::memcpy(undo->image, node, undo->bytes);
+        header->undo_count.store(count + 1, std::memory_order_relaxed);
+        // a writer dies between two instructions, so the node must only not
+        // be changed ahead of the count in program order
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    // put back the nodes and header of the update a writer died inside of,
+    // latest copy first so that every node ends as it was before the update
+    void Rollback(const std::string& name) {
+        Header* header = this->header();
+        std::uint64_t count = header->undo_count.load(std::memory_order_acquire);
+        std::uint64_t log = bytes_ / alignof(Undo) * alignof(Undo);
+        if (count > log / sizeof(Undo)) {
+            throw std::runtime_error("shared tree left inside an update: " + name);
+        }
+        log -= count * sizeof(Undo);
+        for (std::uint64_t i = count; i-- > 0;) {
+            const Undo* undo = UndoAt(i);
+            if (undo->offset < sizeof(Header) || undo->bytes > sizeof(InternalNode) || undo->offset + undo->bytes > log) {
+                throw std::runtime_error("shared tree left inside an update: " + name);
+            }
+            std::memcpy(base_ + undo->offset, undo->image, undo->bytes);
+        }
+        const Snapshot& before = header->before;
+        header->root.store(before.root, std::memory_order_relaxed);
+        header->size.store(before.size, std::memory_order_relaxed);
+        header->height.store(before.height, std::memory_order_relaxed);
+        header->bump = before.bump;
+        header->free_leaves = before.free_leaves;
+        header->free_internals = before.free_internals;
+        header->free_leaf_count = before.free_leaf_count;
+        header->free_internal_count = before.free_internal_count;
+        header->sequence.store(header->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // throws before the update starts if a split on every level and a new
+    // root, or the undo log of the update, would not fit; deletes need no
+    // more log than the inserts that made the tree as tall
+    void Reserve() const {
+        const Header* header = this->header();
+        std::uint64_t internals = static_cast<std::uint64_t>(header->height.load(std::memory_order_relaxed)) + 1;
+        std::uint64_t bump = header->bump;
+        if (header->free_leaf_count == 0) {
+            bump += NodeBytes(true);
+        }
+        if (header->free_internal_count < internals) {
+            bump += (internals - header->free_internal_count) * NodeBytes(false);
+        }
+        if (bump + UndoBytes(internals) > bytes_) {
+            throw std::bad_alloc();
+        }
+    }
+    std::uint64_t NewNode(bool leaf) {
+        Header* header = this->header();
+        std::uint64_t& free_list = leaf ? header->free_leaves : header->free_internals;
+        std::uint64_t offset = free_list;
+        if (offset != 0) {
+            // its link is overwritten below, and needed if the update is rolled back
+            Touch(At(offset), leaf);
+            std::memcpy(&free_list, base_ + offset, sizeof(free_list));
+            --(leaf ? header->free_leaf_count : header->free_internal_count);
+        } else {
+            offset = header->bump;
+            header->bump += NodeBytes(leaf);
+        }
+        At(offset)->count = 0;
+        return offset;
+    }
+    void FreeNode(std::uint64_t offset, bool leaf) {
+        Header* header = this->header();
+        std::uint64_t& free_list = leaf ? header->free_leaves : header->free_internals;
+        Touch(At(offset), leaf);
+        std::memcpy(base_ + offset, &free_list, sizeof(free_list));
+        free_list = offset;
+        ++(leaf ? header->free_leaf_count : header->free_internal_count);
+    }
+
+    // split the full child idx of parent around its middle key
+    void SplitChild(InternalNode* parent, std::size_t idx, std::int64_t child_height) {
+        std::uint64_t right_offset = NewNode(child_height == 0);
+        Node* child = At(parent->childs[idx]);
+        Node* right = At(right_offset);
+        Touch(parent, false);
+        Touch(child, child_height == 0);
+        std::uint32_t mid = kMaxKeys / 2;
+        right->count = kMaxKeys - mid - 1;
+        std::memcpy(right->keys, child->keys + mid + 1, right->count * sizeof(T));
+        if (child_height > 0) {
+            std::memcpy(AsInternal(right)->childs, AsInternal(child)->childs + mid + 1, (right->count + 1) * sizeof(std::uint64_t));
+        }
+        child->count = mid;
+        std::memmove(parent->keys + idx + 1, parent->keys + idx, (parent->count - idx) * sizeof(T));
+        std::memmove(parent->childs + idx + 2, parent->childs + idx + 1, (parent->count - idx) * sizeof(std::uint64_t));
+        parent->keys[idx] = child->keys[mid];
+        parent->childs[idx + 1] = right_offset;
+        ++parent->count;
+    }
+    // child idx + 1 and the key between them go to the end of child idx
+    void MergeChildren(InternalNode* parent, std::size_t idx, std::int64_t child_height) {
+        Node* left = At(parent->childs[idx]);
+        std::uint64_t right_offset = parent->childs[idx + 1];
+        Node* right = At(right_offset);
+        Touch(parent, false);
+        Touch(left, child_height == 0);
+        left->keys[left->count] = parent->keys[idx];
+        std::memcpy(left->keys + left->count + 1, right->keys, right->count * sizeof(T));
+        if (child_height > 0) {
+            std::memcpy(AsInternal(left)->childs + left->count + 1, AsInternal(right)->childs, (right->count + 1) * sizeof(std::uint64_t));
+        }
+        left->count += right->count + 1;
+        std::memmove(parent->keys + idx, parent->keys + idx + 1, (parent->count - idx - 1) * sizeof(T));
+        std::memmove(parent->childs + idx + 1, parent->childs + idx + 2, (parent->count - idx - 1) * sizeof(std::uint64_t));
+        --parent->count;
+        FreeNode(right_offset, child_height == 0);
+    }
+    // give child idx one more key, from a sibling through the parent
+    void Refill(InternalNode* parent, std::size_t idx, std::int64_t child_height) {
+        Node* child = At(parent->childs[idx]);
+        if (idx > 0 && At(parent->childs[idx - 1])->count > kMinKeys) {
+            Node* left = At(parent->childs[idx - 1]);
+            Touch(parent, false);
+            Touch(child, child_height == 0);
+            Touch(left, child_height == 0);
+            std::memmove(child->keys + 1, child->keys, child->count * sizeof(T));
+            child->keys[0] = parent->keys[idx - 1];
+            if (child_height > 0) {
+                std::memmove(AsInternal(child)->childs + 1, AsInternal(child)->childs, (child->count + 1) * sizeof(std::uint64_t));
+                AsInternal(child)->childs[0] = AsInternal(left)->childs[left->count];
+            }
+            parent->keys[idx - 1] = left->keys[left->count - 1];
+            --left->count;
+            ++child->count;
+        } else if (idx < parent->count && At(parent->childs[idx + 1])->count > kMinKeys) {
+            Node* right = At(parent->childs[idx + 1]);
+            Touch(parent, false);
+            Touch(child, child_height == 0);
+            Touch(right, child_height == 0);
+            child->keys[child->count] = parent->keys[idx];
+            if (child_height > 0) {
+                AsInternal(child)->childs[child->count + 1] = AsInternal(right)->childs[0];
+                std::memmove(AsInternal(right)->childs, AsInternal(right)->childs + 1, right->count * sizeof(std::uint64_t));
+            }
+            parent->keys[idx] = right->keys[0];
+            std::memmove(right->keys, right->keys + 1, (right->count - 1) * sizeof(T));
+            --right->count;
+            ++child->count;
+        } else {
+            MergeChildren(parent, idx < parent->count ? idx : idx - 1, child_height);
+        }
+    }
+    // every node entered on the way down has more than kMinKeys keys, so it can lose one
+    void DeleteFrom(Node* node, std::int64_t height, const T& key) {
+        while (true) {
+            std::size_t idx = Rank(node, key);
+            bool here = idx < node->count && node->keys[idx] == key;
+            if (height == 0) {
+                Touch(node, true);
+                std::memmove(node->keys + idx, node->keys + idx + 1, (node->count - idx - 1) * sizeof(T));
+                --node->count;
+                return;
+            }
+            InternalNode* internal = AsInternal(node);
+            if (here) {
+                Node* left = At(internal->childs[idx]);
+                Node* right = At(internal->childs[idx + 1]);
+                if (left->count > kMinKeys) {
+                    T predecessor = Edge(left, height - 1, true);
+                    Touch(node, false);
+                    node->keys[idx] = predecessor;
+                    DeleteFrom(left, height - 1, predecessor);
+                    return;
+                }
+                if (right->count > kMinKeys) {
+                    T successor = Edge(right, height - 1, false);
+                    Touch(node, false);
+                    node->keys[idx] = successor;
+                    DeleteFrom(right, height - 1, successor);
+                    return;
+                }
+                MergeChildren(internal, idx, height - 1);
+                node = left;
+                --height;
+                continue;
+            }
+            if (At(internal->childs[idx])->count <= kMinKeys) {
+                std::uint32_t count = node->count;
+                Refill(internal, idx, height - 1);
+                // merged into the left sibling, which is where the keys are now
+                if (idx == count && node->count < count) {
+                    --idx;
+                }
+            }
+            node = At(internal->childs[idx]);
+            --height;
+        }
+    }
+    // largest (or smallest) key of the subtree
+    T Edge(Node* node, std::int64_t height, bool largest) const {
+        for (; height > 0; --height) {
+            node = At(AsInternal(node)->childs[largest ? node->count : 0]);
+        }
+        return node->keys[largest ? node->count - 1 : 0];
+    }
+};
+
+#endif
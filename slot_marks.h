@@ -0,0 +1,164 @@
+#ifndef MY_SLOT_MARKS
+#define MY_SLOT_MARKS
+
+#include<bit>
+#include<cstddef>
+#include<cstdint>
+#include<memory>
+#include<vector>
+
+
+// One bit per key slot of a node, set for keys deleted lazily. Nodes without
+// marks, all of them unless lazy deletes are on, hold a null pointer: no
+// allocation and one word per node. The bits move with the keys, so every
+// operation that shifts, splits or joins the keys of a node does the same
+// to its marks.
+class SlotMarks {
+public:
+    SlotMarks() = default;
+    SlotMarks(SlotMarks&&) noexcept = default;
+    SlotMarks& operator=(SlotMarks&&) noexcept = default;
+
+    bool Any() const {
+        return words_ != nullptr;
+    }
+    bool Test(std::size_t idx) const {
+        return words_ && idx / 64 < words_->size() && ((*words_)[idx / 64] >> (idx % 64) & 1) != 0;
+    }
+    void Set(std::size_t idx, bool marked = true) {
+        if (marked) {
+            Grow(idx / 64 + 1);
+            (*words_)[idx / 64] |= std::uint64_t(1) << (idx % 64);
+        } else if (Test(idx)) {
+            (*words_)[idx / 64] &= ~(std::uint64_t(1) << (idx % 64));
+            Trim();
+        }
+    }
+    std::size_t Count() const {
+        std::size_t count = 0;
+        if (words_) {
+            for (std::uint64_t word : *words_) {
+                count += std::popcount(word);
+            }
+        }
+        return count;
+    }
+    // a new slot at idx, the slots from idx on move up by one
+    void InsertAt(std::size_t idx, bool marked) {
+        if (!words_ && !marked) {
+            return;
+        }
+        Grow(idx / 64 + 1);
+        std::vector<std::uint64_t>& words = *words_;
+        if (words.back() >> 63 != 0) {
+            words.push_back(0);
+        }
+        std::size_t first = idx / 64;
+        for (std::size_t w = words.size() - 1; w > first; --w) {
+            words[w] = words[w] << 1 | words[w - 1] >> 63;
+        }
+        std::uint64_t below = LowMask(idx % 64);
+        words[first] = (words[first] & below) | (words[first] & ~below) << 1
+            | std::uint64_t(marked) << (idx % 64);
+        Trim();
+    }
+    // drop slot idx, the slots above move down by one; returns its mark
+    bool EraseAt(std::size_t idx) {
+        if (!words_ || idx / 64 >= words_->size()) {
+            return false;
+        }
+        bool marked = Test(idx);
+        std::vector<std::uint64_t>& words = *words_;
+        std::size_t first = idx / 64;
+        std::uint64_t below = LowMask(idx % 64);
+        words[first] = (words[first] & below) | (words[first] >> 1 & ~below);
+        for (std::size_t w = first; w < words.size(); ++w) {
+            if (w > first) {
+                words[w] >>= 1;
+            }
+            if (w + 1 < words.size()) {
+                words[w] |= words[w + 1] << 63;
+            }
+        }
+        Trim();
+        return marked;
+    }
+    // drop the first count slots
+    void EraseFront(std::size_t count) {
+        SlotMarks rest;
+        ForEach([&rest, count](std::size_t idx) {
+            if (idx >= count) {
+                rest.Set(idx - count);
+            }
+        });
+        *this = std::move(rest);
+    }
+    // the slots after mid go to the empty right, those from mid on are
+    // dropped here; returns the mark of mid
+    bool SplitAt(std::size_t mid, SlotMarks& right) {
+        bool marked = Test(mid);
+        SlotMarks left;
+        ForEach([&left, &right, mid](std::size_t idx) {
+            if (idx < mid) {
+                left.Set(idx);
+            } else if (idx > mid) {
+                right.Set(idx - mid - 1);
+            }
+        });
+        *this = std::move(left);
+        return marked;
+    }
+    // take the marks of other's size slots, placed before or after our size slots
+    void Absorb(SlotMarks&& other, std::size_t size, std::size_t other_size, bool front) {
+        if (!other.Any() && (!front || !Any())) {
+            return;
+        }
+        SlotMarks joined;
+        std::size_t ours = front ? other_size : 0;
+        std::size_t theirs = front ? 0 : size;
+        ForEach([&joined, ours](std::size_t idx) {
+            joined.Set(idx + ours);
+        });
+        other.ForEach([&joined, theirs](std::size_t idx) {
+            joined.Set(idx + theirs);
+        });
+        *this = std::move(joined);
+        other.words_ = nullptr;
+    }
+    template <typename Visit>
+    void ForEach(Visit&& visit) const {
+        if (!words_) {
+            return;
+        }
+        for (std::size_t w = 0; w < words_->size(); ++w) {
+            for (std::uint64_t word = (*words_)[w]; word != 0; word &= word - 1) {
+                visit(w * 64 + std::countr_zero(word));
+            }
+        }
+    }
+private:
+    std::unique_ptr<std::vector<std::uint64_t>> words_;
+
+    static std::uint64_t LowMask(std::size_t bits) {
+        return (std::uint64_t(1) << bits) - 1;
+    }
+    void Grow(std::size_t words) {
+        if (!words_) {
+            words_ = std::make_unique<std::vector<std::uint64_t>>();
+        }
+        if (words_->size() < words) {
+            words_->resize(words);
+        }
+    }
+    // no trailing zero words, and no vector without a mark
+    void Trim() {
+        while (!words_->empty() && words_->back() == 0) {
+            words_->pop_back();
+        }
+        if (words_->empty()) {
+            words_ = nullptr;
+        }
+    }
+};
+
+#endif
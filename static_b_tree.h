@@ -0,0 +1,63 @@
+#ifndef MY_STATIC_B_TREE
+#define MY_STATIC_B_TREE
+
+#include<algorithm>
+#include<array>
+#include<cstddef>
+#include"node_search.h"
+
+
+// Frozen B-tree of a fixed key set, built by a constexpr constructor from an
+// array, so a constexpr tree is computed by the compiler and lands in the
+// read-only data of the binary: no construction at startup, and processes
+// running the binary share its pages. Nodes of Order - 1 keys sit in one
+// array in breadth-first order with implicit links, node k has the children
+// k * Order + 1 to k * Order + Order; slots past the last key repeat it.
+// Find works in constant expressions and at run time.
+template <typename T, std::size_t N, int Order = 16>
+class StaticBTree {
+    static_assert(Order >= 2, "StaticBTree needs Order >= 2");
+    static constexpr std::size_t kNodeKeys = Order - 1;
+    static constexpr std::size_t kNodes = (N + kNodeKeys - 1) / kNodeKeys;
+public:
+    // keys in any order, duplicates are dropped
+    constexpr explicit StaticBTree(std::array<T, N> keys) {
+        std::sort(keys.begin(), keys.end());
+        size_ = static_cast<std::size_t>(std::unique(keys.begin(), keys.end()) - keys.begin());
+        std::size_t next = 0;
+        Fill(0, keys, next);
+    }
+    constexpr bool Find(const T& key) const {
+        std::size_t node = 0;
+        while (node < kNodes) {
+            const T* keys = keys_.data() + node * kNodeKeys;
+            std::size_t idx = node_search::Bisect(keys, key, 0, kNodeKeys);
+            if (idx < kNodeKeys && keys[idx] == key) {
+                return true;
+            }
+            node = node * Order + idx + 1;
+        }
+        return false;
+    }
+    constexpr std::size_t Size() const {
+        return size_;
+    }
+private:
+    std::array<T, kNodes * kNodeKeys> keys_{};
+    std::size_t size_ = 0;
+
+    // in-order walk of the implicit tree, handing out the sorted keys
+    constexpr void Fill(std::size_t node, const std::array<T, N>& sorted, std::size_t& next) {
+        if (node >= kNodes) {
+            return;
+        }
+        for (std::size_t i = 0; i < kNodeKeys; ++i) {
+            Fill(node * Order + i + 1, sorted, next);
+            keys_[node * kNodeKeys + i] = sorted[std::min(next, size_ - 1)];
+            ++next;
+        }
+        Fill(node * Order + Order, sorted, next);
+    }
+};
+
+#endif
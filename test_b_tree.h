@@ -6,36 +6,59 @@
 #include <vector>
 #include <random>
 #include <climits>
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <tuple>
+#include <set>
 #include "b_tree.h" // Assumes template: BTree<KeyType, Order>
+#include "hybrid_set.h"
+
+// Key without default constructor and copy operations
+struct MoveOnlyKey {
+    std::unique_ptr<int> value;
+    explicit MoveOnlyKey(int v) : value(std::make_unique<int>(v)) {}
+    bool operator<(const MoveOnlyKey& other) const { return *value < *other.value; }
+    bool operator==(const MoveOnlyKey& other) const { return *value == *other.value; }
+    bool operator!=(const MoveOnlyKey& other) const { return *value != *other.value; }
+    friend std::ostream& operator<<(std::ostream& os, const MoveOnlyKey& key) { return os << *key.value; }
+};
 
 template<typename KeyType, int Order>
 class TestBTree {
 private:
-    using Node = typename BTree<KeyType, Order>::Node;
-
-    // Helper: recursively validate B-tree invariants
-    bool ValidateNode(const Node* node, const KeyType& min_val, const KeyType& max_val) {
+    // Helper: recursively validate B-tree invariants, a null bound means unbounded.
+    // height is the one the tree derives for node, leaves are exactly those at 0.
+    template<typename Node, typename Key>
+    bool ValidateNode(const Node* node, const Key* min_val, const Key* max_val, int leaf_order, int internal_order,
+                      int height) {
         if (!node) return true;
 
         const auto& keys = node->keys;
-        const auto& childs = node->childs;
+        const auto& childs = node->Children();
+        if (node->IsLeaf() != (height == 0) || childs.empty() != (height == 0)) return false;
 
         // B-tree property: 1 <= keys.size() <= Order - 1 (except root may be empty if tree is empty)
+        int order = childs.empty() ? leaf_order : internal_order;
         if (keys.empty()) return false;
-        if (keys.size() > static_cast<size_t>(Order - 1)) {
+        if (keys.size() > static_cast<size_t>(order - 1)) {
             return false;
         }
 
         // Keys must be strictly increasing
         for (size_t i = 1; i < keys.size(); ++i) {
-            if (keys[i - 1] >= keys[i]) {
+            if (!(keys[i - 1] < keys[i])) {
                 return false;
             }
         }
 
         // All keys must be in (min_val, max_val)
         for (const auto& key : keys) {
-            if (key <= min_val || key >= max_val) {
+            if ((min_val && !(*min_val < key)) || (max_val && !(key < *max_val))) {
                 return false;
             }
         }
@@ -50,12 +73,21 @@ private:
             return false;
         }
 
-        // For root with only one key, min/max are INT bounds; generalize for any KeyType if needed
-        if (!ValidateNode(childs[0].get(), min_val, keys[0])) return false;
-        for (size_t i = 0; i < keys.size(); ++i) {
+        // decoding storages return keys by value, keep them alive for the bounds
+        std::vector<Key> decoded;
+        std::vector<const Key*> separators;
+        if constexpr (std::is_reference_v<decltype(keys[0])>) {
+            for (size_t i = 0; i < keys.size(); ++i) separators.push_back(&keys[i]);
+        } else {
+            decoded.assign(keys.begin(), keys.end());
+            for (const auto& key : decoded) separators.push_back(&key);
+        }
+        if (!ValidateNode(childs[0].get(), min_val, separators[0], leaf_order, internal_order, height - 1)) return false;
+        for (size_t i = 0; i < separators.size(); ++i) {
             if (!ValidateNode(childs[i + 1].get(),
-                              keys[i],
-                              (i + 1 < keys.size()) ? keys[i + 1] : max_val)) {
+                              separators[i],
+                              (i + 1 < separators.size()) ? separators[i + 1] : max_val,
+                              leaf_order, internal_order, height - 1)) {
                 return false;
             }
         }
@@ -63,20 +95,13 @@ private:
         return true;
     }
 
-    bool IsValidTree(const BTree<KeyType, Order>& tree) {
+    template<typename Tree>
+    bool IsValidTree(const Tree& tree) {
         if (!tree.root) return true;
 
-        // Use min/max for KeyType if possible; fallback for int
-        KeyType min_bound = std::numeric_limits<KeyType>::lowest();
-        KeyType max_bound = std::numeric_limits<KeyType>::max();
-
-        // Special case: if KeyType is int, avoid overflow in comparisons
-        if constexpr (std::is_same_v<KeyType, int>) {
-            min_bound = INT32_MIN;
-            max_bound = INT32_MAX;
-        }
-
-        return ValidateNode(tree.root.get(), min_bound, max_bound);
+        using Key = std::decay_t<decltype(tree.root->keys[0])>;
+        return ValidateNode(tree.root.get(), static_cast<const Key*>(nullptr), static_cast<const Key*>(nullptr),
+                            tree.LeafOrder(), tree.InternalOrder(), tree.Height());
     }
 
 public:
@@ -102,7 +127,7 @@ public:
             assert(tree.Find(i * 10));
         }
         assert(tree.root->keys.size() == static_cast<size_t>(Order - 1));
-        assert(tree.root->childs.empty()); // still leaf
+        assert(tree.root->Children().empty()); // still leaf
         assert(IsValidTree(tree));
     }
 
@@ -115,7 +140,7 @@ public:
 
         // After split: root has 1 key, 2 children
         assert(tree.root->keys.size() == 1);
-        assert(tree.root->childs.size() == 2);
+        assert(tree.root->Children().size() == 2);
         for (int i = 1; i <= Order; ++i) {
             assert(tree.Find(i * 10));
         }
@@ -220,7 +245,7 @@ public:
             assert(IsValidTree(tree));
         }
         assert(tree.Find(1));
-        assert(tree.root->childs.empty()); // Leaf
+        assert(tree.root->Children().empty()); // Leaf
         tree.PrintTreeLevels();
         tree.Delete(1);
         assert(!tree.Find(1));
@@ -268,6 +293,1253 @@ public:
         assert(IsValidTree(tree));
     }
 
+    void TestPrefixCompressedKeys() {
+        BTree<std::string, Order, PrefixKeys<std::string> > tree;
+        std::vector<std::string> values;
+        for (int i = 0; i < 500; ++i) {
+            values.push_back("tenant/eu-west/customer/" + std::to_string(100000 + i * 7));
+        }
+        std::mt19937 g(42);
+        std::shuffle(values.begin(), values.end(), g);
+        for (const auto& v : values) {
+            tree.Insert(v);
+            assert(tree.Find(v));
+        }
+        assert(IsValidTree(tree));
+        assert(!tree.Find("tenant/eu-west/customer/"));
+        assert(!tree.Find("tenant/eu-west/customer/1000001"));
+        assert(!tree.Find("tenant/us-east/customer/100000"));
+        assert(!tree.Find("a"));
+        assert(!tree.Find("z"));
+
+        // every node stores the shared part of its keys once
+        auto* leaf = tree.root.get();
+        while (!leaf->Children().empty()) leaf = leaf->Children()[0].get();
+        assert(leaf->keys.Prefix().size() >= std::string("tenant/eu-west/customer/1").size());
+
+        for (std::size_t i = 0; i < values.size() / 2; ++i) {
+            tree.Delete(values[i]);
+            assert(!tree.Find(values[i]));
+        }
+        for (std::size_t i = values.size() / 2; i < values.size(); ++i) {
+            assert(tree.Find(values[i]));
+        }
+        assert(IsValidTree(tree));
+    }
+
+    template<typename Node>
+    std::size_t KeyBytes(const Node* node) {
+        std::size_t bytes = node->keys.KeyBytes();
+        for (const auto& child : node->Children()) {
+            bytes += KeyBytes(child.get());
+        }
+        return bytes;
+    }
+
+    void TestFrameOfReferenceKeys() {
+        constexpr int kWideOrder = 8 * Order;
+        BTree<std::int64_t, kWideOrder, FrameOfReferenceKeys<std::int64_t> > tree;
+        const std::int64_t base = 5000000000LL;
+        const int N = 4000;
+        std::vector<std::int64_t> values;
+        for (int i = 0; i < N; ++i) {
+            values.push_back(base + i);
+        }
+        std::mt19937 g(7);
+        std::shuffle(values.begin(), values.end(), g);
+        for (auto v : values) {
+            tree.Insert(v);
+            assert(tree.Find(v));
+        }
+        assert(IsValidTree(tree));
+        assert(!tree.Find(base - 1));
+        assert(!tree.Find(base + N));
+        assert(!tree.Find(-base));
+        // dense ids are stored with one byte per key, plus the node bases
+        assert(KeyBytes(tree.root.get()) < static_cast<std::size_t>(N) * 4);
+
+        // keys far from the frame widen the node only where they land
+        tree.Insert(base + (1LL << 40));
+        tree.Insert(-base);
+        assert(tree.Find(base + (1LL << 40)));
+        assert(tree.Find(-base));
+
+        for (int i = 0; i < N / 2; ++i) {
+            tree.Delete(values[i]);
+            assert(!tree.Find(values[i]));
+        }
+        for (int i = N / 2; i < N; ++i) {
+            assert(tree.Find(values[i]));
+        }
+        assert(IsValidTree(tree));
+    }
+
+    template<typename Node>
+    void CountContainers(const Node* node, std::size_t (&kinds)[3]) {
+        ++kinds[static_cast<int>(node->keys.Kind())];
+        for (const auto& child : node->Children()) {
+            CountContainers(child.get(), kinds);
+        }
+    }
+
+    void TestHybridKeys() {
+        constexpr int kWideOrder = 64 * Order;
+        HybridBTree<std::uint32_t, kWideOrder> tree;
+        std::vector<std::uint32_t> values;
+        // a dense block with holes, sparse ids, and short runs
+        for (std::uint32_t i = 0; i < 20000; ++i) {
+            if (i % 3 != 0) values.push_back(1000000 + i);
+        }
+        for (std::uint32_t i = 0; i < 2000; ++i) {
+            values.push_back(5000000 + i * 1000);
+        }
+        for (std::uint32_t i = 0; i < 200; ++i) {
+            for (std::uint32_t k = 0; k < 50; ++k) values.push_back(9000000 + i * 1000 + k);
+        }
+        std::mt19937 g(11);
+        std::shuffle(values.begin(), values.end(), g);
+        for (auto v : values) {
+            tree.Insert(v);
+        }
+        assert(IsValidTree(tree));
+        for (auto v : values) {
+            assert(tree.Find(v));
+        }
+        assert(!tree.Find(999999));
+        assert(!tree.Find(1000003));
+        assert(!tree.Find(5000001));
+        assert(!tree.Find(9000050));
+
+        std::size_t kinds[3] = {0, 0, 0};
+        CountContainers(tree.root.get(), kinds);
+        assert(kinds[0] > 0 && kinds[1] > 0 && kinds[2] > 0);
+        assert(KeyBytes(tree.root.get()) < values.size() * sizeof(std::uint32_t) / 2);
+
+        std::set<std::uint32_t> expected(values.begin(), values.end());
+        for (std::size_t i = 0; i < values.size() / 2; ++i) {
+            tree.Delete(values[i]);
+            expected.erase(values[i]);
+        }
+        assert(IsValidTree(tree));
+        for (auto v : values) {
+            assert(tree.Find(v) == (expected.count(v) > 0));
+        }
+        std::vector<std::uint32_t> visited;
+        tree.ForEachInRange(0, 4000000000u, [&visited](std::uint32_t v) { visited.push_back(v); });
+        assert(visited == std::vector<std::uint32_t>(expected.begin(), expected.end()));
+    }
+
+    void TestHybridSetOperations() {
+        constexpr int kWideOrder = 64 * Order;
+        using Tree = HybridBTree<std::uint32_t, kWideOrder>;
+        Tree evens;
+        Tree dense;
+        std::set<std::uint32_t> left;
+        std::set<std::uint32_t> right;
+        std::mt19937 g(5);
+        for (std::uint32_t v = 0; v < 30000; v += 2) {
+            evens.Insert(v);
+            left.insert(v);
+        }
+        // runs, sparse keys and a bitmap-friendly block, overlapping the evens in part
+        for (std::uint32_t v = 10000; v < 14000; ++v) {
+            dense.Insert(v);
+            right.insert(v);
+        }
+        for (int i = 0; i < 3000; ++i) {
+            std::uint32_t v = g() % 60000;
+            dense.Insert(v);
+            right.insert(v);
+        }
+        for (std::uint32_t v = 20000; v < 26000; v += 3) {
+            dense.Insert(v);
+            right.insert(v);
+        }
+
+        std::vector<std::uint32_t> both;
+        std::vector<std::uint32_t> either;
+        std::set_intersection(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(both));
+        std::set_union(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(either));
+        auto contents = [](Tree& tree) {
+            std::vector<std::uint32_t> keys;
+            tree.ForEachInRange(0, UINT32_MAX, [&keys](std::uint32_t v) { keys.push_back(v); });
+            return keys;
+        };
+
+        Tree intersection = Intersect(evens, dense);
+        Tree united = Union(evens, dense);
+        assert(contents(intersection) == both);
+        assert(contents(united) == either);
+        assert(intersection.Size() == both.size() && united.Size() == either.size());
+        assert(IsValidTree(intersection) && IsValidTree(united));
+        Tree swapped_intersection = Intersect(dense, evens);
+        Tree swapped_union = Union(dense, evens);
+        assert(contents(swapped_intersection) == both);
+        assert(contents(swapped_union) == either);
+
+        // with an empty tree and with a flat one
+        Tree empty;
+        assert(Intersect(evens, empty).Size() == 0);
+        Tree copy = Union(empty, evens);
+        assert(contents(copy) == std::vector<std::uint32_t>(left.begin(), left.end()));
+        Tree flat;
+        flat.SetFlatLimit(16);
+        flat.Insert(10);
+        flat.Insert(11);
+        flat.Insert(10001);
+        Tree flat_intersection = Intersect(flat, dense);
+        assert(contents(flat_intersection).size() == right.count(10) + right.count(11) + 1);
+        assert(Union(flat, evens).Size() == left.size() + 2);
+    }
+
+    void TestRuntimeOrder() {
+        BTree<int, kRuntimeOrder> tree(2 * Order, Order);
+        assert(tree.LeafOrder() == 2 * Order);
+        assert(tree.InternalOrder() == Order);
+        const int N = 2000;
+        std::vector<int> values;
+        for (int i = 1; i <= N; ++i) {
+            values.push_back(i);
+        }
+        std::mt19937 g(11);
+        std::shuffle(values.begin(), values.end(), g);
+        for (int v : values) {
+            tree.Insert(v);
+        }
+        assert(IsValidTree(tree));
+        std::shuffle(values.begin(), values.end(), g);
+        for (int i = 0; i < N / 2; ++i) {
+            tree.Delete(values[i]);
+            assert(!tree.Find(values[i]));
+        }
+        for (int i = N / 2; i < N; ++i) {
+            assert(tree.Find(values[i]));
+        }
+        assert(IsValidTree(tree));
+
+        // default limits follow the cache line, internal nodes also hold child pointers
+        BTree<std::int64_t, kRuntimeOrder> sized;
+        assert(sized.LeafOrder() >= 3 && sized.InternalOrder() >= 3);
+        assert(sized.LeafOrder() > sized.InternalOrder());
+        BTree<int, kRuntimeOrder> clamped(1, 2);
+        assert(clamped.LeafOrder() == 3 && clamped.InternalOrder() == 3);
+    }
+
+    void TestFingerOperations() {
+        BTree<int, Order> tree;
+        typename BTree<int, Order>::Cursor hint;
+        // monotonically increasing keys, every insert lands next to the previous one
+        const int N = 3000;
+        for (int i = 1; i <= N; ++i) {
+            tree.Insert(hint, i * 2);
+            assert(tree.Find(hint, i * 2));
+        }
+        assert(IsValidTree(tree));
+        tree.Insert(hint, N); // duplicate
+        assert(IsValidTree(tree));
+
+        // nearby keys on both sides of the finger
+        for (int i = N; i >= 1; --i) {
+            tree.Insert(hint, i * 2 - 1);
+        }
+        assert(IsValidTree(tree));
+        for (int i = 1; i <= 2 * N; ++i) {
+            assert(tree.Find(hint, i));
+            assert(tree.Find(i));
+        }
+        assert(!tree.Find(hint, 0));
+        assert(!tree.Find(hint, 2 * N + 1));
+
+        // plain modifications invalidate the finger, hinted calls restart from root
+        typename BTree<int, Order>::Cursor other;
+        assert(tree.Find(other, 100));
+        tree.Delete(101);
+        tree.Insert(hint, 101);
+        assert(tree.Find(other, 101));
+        for (int i = 1; i <= 2 * N; i += 3) {
+            tree.Delete(i);
+            assert(!tree.Find(other, i));
+        }
+        for (int i = 1; i <= 2 * N; i += 3) {
+            tree.Insert(other, i);
+        }
+        assert(IsValidTree(tree));
+        for (int i = 1; i <= 2 * N; ++i) {
+            assert(tree.Find(hint, i));
+        }
+    }
+
+    void TestMoveOnlyKeys() {
+        BTree<MoveOnlyKey, Order> tree;
+        const int N = 1000;
+        std::vector<int> values;
+        for (int i = 1; i <= N; ++i) {
+            values.push_back(i);
+        }
+        std::mt19937 g(3);
+        std::shuffle(values.begin(), values.end(), g);
+        for (int v : values) {
+            if (v % 2) {
+                tree.Insert(MoveOnlyKey(v));
+            } else {
+                tree.Emplace(v);
+            }
+        }
+        tree.Emplace(values[0]); // duplicate
+        assert(IsValidTree(tree));
+        for (int v = 1; v <= N; ++v) {
+            assert(tree.Find(MoveOnlyKey(v)));
+        }
+        std::shuffle(values.begin(), values.end(), g);
+        for (int i = 0; i < N / 2; ++i) {
+            tree.Delete(MoveOnlyKey(values[i]));
+            assert(!tree.Find(MoveOnlyKey(values[i])));
+        }
+        for (int i = N / 2; i < N; ++i) {
+            assert(tree.Find(MoveOnlyKey(values[i])));
+        }
+        assert(IsValidTree(tree));
+    }
+
+    template<typename Node>
+    void CountNodes(const Node* node, std::size_t& nodes, std::size_t& keys) {
+        ++nodes;
+        keys += node->keys.size();
+        for (const auto& child : node->Children()) {
+            CountNodes(child.get(), nodes, keys);
+        }
+    }
+
+    template<typename Node>
+    std::size_t CountMarks(const Node* node) {
+        std::size_t marks = node->marks.Count();
+        for (const auto& child : node->Children()) {
+            marks += CountMarks(child.get());
+        }
+        return marks;
+    }
+
+    void TestRedistribution() {
+        BTree<int, Order> tree;
+        const int N = 2000;
+        std::vector<int> values;
+        for (int i = 1; i <= N; ++i) {
+            values.push_back(i);
+        }
+        std::mt19937 g(5);
+        std::shuffle(values.begin(), values.end(), g);
+        for (int v : values) {
+            tree.Insert(v);
+        }
+        assert(IsValidTree(tree));
+
+        // rotations and 2-to-3 splits keep nodes well above half full
+        std::size_t nodes = 0;
+        std::size_t keys = 0;
+        CountNodes(tree.root.get(), nodes, keys);
+        assert(keys == static_cast<std::size_t>(N));
+        assert(keys * 10 >= nodes * (Order - 1) * 7);
+        assert(tree.Stats().rotations > 0);
+        assert(tree.Stats().splits < nodes);
+        assert(tree.Stats().merges == 0);
+
+        std::shuffle(values.begin(), values.end(), g);
+        std::size_t rotations = tree.Stats().rotations;
+        for (int i = 0; i < N / 2; ++i) {
+            tree.Delete(values[i]);
+        }
+        assert(IsValidTree(tree));
+        assert(tree.Stats().rotations > rotations);
+        for (int i = N / 2; i < N; ++i) {
+            assert(tree.Find(values[i]));
+        }
+    }
+
+    void TestLazyDelete() {
+        BTree<int, Order> tree;
+        const int N = 1000;
+        for (int i = 1; i <= N; ++i) {
+            tree.Insert(i);
+        }
+        std::size_t nodes = 0;
+        std::size_t keys = 0;
+        CountNodes(tree.root.get(), nodes, keys);
+        TreeStats before = tree.Stats();
+
+        // deletes below the density threshold leave the nodes untouched
+        tree.EnableLazyDelete(0.5);
+        for (int i = 1; i <= N / 4; ++i) {
+            tree.Delete(i);
+        }
+        std::size_t lazy_nodes = 0;
+        std::size_t lazy_keys = 0;
+        CountNodes(tree.root.get(), lazy_nodes, lazy_keys);
+        assert(lazy_nodes == nodes && lazy_keys == keys);
+        assert(tree.Stats().merges == before.merges);
+        assert(tree.Tombstones() == static_cast<std::size_t>(N / 4));
+        assert(CountMarks(tree.root.get()) == tree.Tombstones());
+        assert(tree.Size() == static_cast<std::size_t>(N - N / 4));
+        for (int i = 1; i <= N; ++i) {
+            assert(tree.Find(i) == (i > N / 4));
+        }
+        tree.Delete(1);
+        assert(tree.Tombstones() == static_cast<std::size_t>(N / 4));
+
+        // inserting a marked key revives it
+        tree.Insert(7);
+        assert(tree.Find(7));
+        assert(tree.Tombstones() == static_cast<std::size_t>(N / 4 - 1));
+
+        tree.Compact();
+        assert(tree.Tombstones() == 0);
+        assert(IsValidTree(tree));
+        std::size_t compact_nodes = 0;
+        std::size_t compact_keys = 0;
+        CountNodes(tree.root.get(), compact_nodes, compact_keys);
+        assert(compact_keys == tree.Size());
+
+        // past the threshold deletes drop the marked keys of the leaves they
+        // land in, still without merges or rotations
+        TreeStats compacted = tree.Stats();
+        for (int i = N / 4 + 1; i <= N; ++i) {
+            tree.Delete(i);
+        }
+        assert(tree.Stats().merges == compacted.merges && tree.Stats().rotations == compacted.rotations);
+        std::size_t purged_nodes = 0;
+        std::size_t purged_keys = 0;
+        CountNodes(tree.root.get(), purged_nodes, purged_keys);
+        assert(purged_nodes == compact_nodes && purged_keys < compact_keys);
+        assert(purged_keys == tree.Size() + tree.Tombstones() && CountMarks(tree.root.get()) == tree.Tombstones());
+        assert(tree.Size() == 1 && tree.Find(7) && *tree.Min() == 7 && *tree.Max() == 7);
+        tree.DisableLazyDelete();
+        assert(IsValidTree(tree));
+        tree.Delete(7);
+        assert(tree.root == nullptr && tree.Size() == 0);
+
+        // leaves about to split reuse the slots of marked keys, marks travel
+        // with their keys through splits and merges
+        BTree<int, Order> reused;
+        reused.EnableLazyDelete(1.0);
+        for (int i = 0; i < 2000; i += 2) {
+            reused.Insert(i);
+        }
+        for (int i = 0; i < 2000; i += 4) {
+            reused.Delete(i);
+        }
+        std::size_t marked = reused.Tombstones();
+        for (int i = 1; i < 2000; i += 2) {
+            reused.Insert(i);
+        }
+        assert(reused.Tombstones() < marked && CountMarks(reused.root.get()) == reused.Tombstones());
+        for (int i = 0; i < 2000; ++i) {
+            assert(reused.Find(i) == (i % 4 != 0));
+        }
+        for (int i = 1; i < 2000; i += 4) {
+            reused.Delete(i);
+        }
+        reused.DisableLazyDelete();
+        for (int i = 1000; i < 2000; ++i) {
+            reused.Delete(i);
+        }
+        assert(IsValidTree(reused) && reused.Tombstones() == 0 && reused.Size() == 500);
+        for (int i = 0; i < 2000; ++i) {
+            assert(reused.Find(i) == (i < 1000 && i % 4 >= 2));
+        }
+    }
+
+    void TestFindAsync() {
+        BTree<int, Order> tree;
+        std::vector<int> keys;
+        for (int i = 0; i < 2000; ++i) {
+            if (i % 3 != 0) tree.Insert(i);
+            keys.push_back(i);
+        }
+        assert(tree.FindAsync(1).Get());
+        assert(!tree.FindAsync(3).Get());
+        std::vector<bool> found = FindInterleaved(tree, keys, 8);
+        for (int i = 0; i < 2000; ++i) {
+            assert(found[i] == (i % 3 != 0));
+        }
+
+        // marked keys are skipped like in Find
+        tree.EnableLazyDelete();
+        tree.Delete(1);
+        assert(!tree.FindAsync(1).Get());
+        assert(FindInterleaved(tree, std::vector<int>{}).empty());
+    }
+
+    void TestHugePageNodes() {
+        auto used = [] {
+            std::size_t bytes = 0;
+            for (const ArenaStats& stats : NodeArena::MemoryStats()) {
+                assert(stats.used_bytes <= stats.reserved_bytes);
+                assert(stats.huge_page_regions <= stats.regions);
+                bytes += stats.used_bytes;
+            }
+            return bytes;
+        };
+        std::size_t before = used();
+        {
+            HugePageBTree<int, Order> tree;
+            std::vector<int> values;
+            for (int i = 0; i < 5000; ++i) {
+                values.push_back(i);
+            }
+            std::mt19937 g(36);
+            std::shuffle(values.begin(), values.end(), g);
+            for (int v : values) {
+                tree.Insert(v);
+            }
+            for (int i = 0; i < 2500; ++i) {
+                tree.Delete(values[i]);
+            }
+            assert(IsValidTree(tree));
+            for (int i = 0; i < 5000; ++i) {
+                assert(tree.Find(values[i]) == (i >= 2500));
+            }
+            assert(used() > before);
+        }
+        assert(used() == before);
+
+        // nodes built by another thread are freed back to its arena
+        auto tree = std::make_unique<HugePageBTree<int, Order>>();
+        std::thread builder([&tree] {
+            for (int i = 0; i < 5000; ++i) {
+                tree->Insert(i);
+            }
+        });
+        builder.join();
+        assert(used() > before);
+        tree = nullptr;
+        assert(used() == before);
+    }
+
+    void TestProfiler() {
+        // a fresh thread has its own profiler, the tree's macros may be feeding this one
+        std::thread profiled([] {
+            TreeProfiler& profiler = TreeProfiler::ThisThread();
+            profiler.SetSamplePeriod(2);
+            for (int i = 0; i < 4; ++i) {
+                TreeProfiler::OpScope op(TreeOp::kFind);
+                profiler.Descent();
+                for (int level = 0; level < 3; ++level) {
+                    profiler.Visit();
+                    profiler.Comparisons(2);
+                    // nested operations are part of the outer one
+                    TreeProfiler::OpScope nested(TreeOp::kInsert);
+                    profiler.Visit();
+                }
+            }
+            assert(profiler.Operations(TreeOp::kFind) == 4);
+            assert(profiler.SampledOperations(TreeOp::kFind) == 2);
+            assert(profiler.Operations(TreeOp::kInsert) == 0);
+            for (int level = 0; level < 3; ++level) {
+                assert(profiler.Level(TreeOp::kFind, level).visits == 2);
+                assert(profiler.Level(TreeOp::kFind, level).comparisons == 4);
+            }
+            assert(profiler.Level(TreeOp::kFind, 3).visits == 0);
+
+            // a walk resumed from a cursor starts below the root
+            {
+                TreeProfiler::OpScope op(TreeOp::kDelete);
+                profiler.Descent(2);
+                profiler.Visit();
+            }
+            {
+                TreeProfiler::OpScope op(TreeOp::kDelete);
+                profiler.Descent(2);
+                profiler.Visit();
+            }
+            assert(profiler.Level(TreeOp::kDelete, 2).visits == 1);
+            assert(profiler.Level(TreeOp::kDelete, 0).visits == 0);
+
+            std::ostringstream report;
+            profiler.Report(report);
+            assert(report.str().find("Find") != std::string::npos);
+            assert(report.str().find("Insert") == std::string::npos);
+            profiler.Reset();
+            assert(profiler.Operations(TreeOp::kFind) == 0);
+            assert(profiler.Level(TreeOp::kFind, 0).visits == 0);
+        });
+        profiled.join();
+
+        // trees report through the profiler only in profiling builds
+        [[maybe_unused]] std::uint64_t before = TreeProfiler::ThisThread().Operations(TreeOp::kInsert);
+        BTree<int, Order> tree;
+        for (int i = 0; i < 100; ++i) {
+            tree.Insert(i);
+        }
+        assert(tree.Find(50));
+#ifdef ENABLE_PROFILING
+        assert(TreeProfiler::ThisThread().Operations(TreeOp::kInsert) == before + 100);
+#endif
+    }
+
+    void TestClear() {
+        BTree<int, Order> tree;
+        for (int i = 0; i < 5000; ++i) {
+            tree.Insert(i);
+        }
+        typename BTree<int, Order>::Cursor hint;
+        assert(tree.Find(hint, 10));
+        tree.Clear();
+        assert(tree.root == nullptr);
+        assert(tree.Size() == 0);
+        assert(!tree.Find(hint, 10));
+        tree.Insert(hint, 7);
+        assert(tree.Find(7) && tree.Size() == 1);
+
+        // a rebuilt tree swapped in, the old nodes go to the background thread
+        BTree<int, Order> rebuilt;
+        for (int i = 0; i < 5000; i += 2) {
+            rebuilt.Insert(i);
+        }
+        tree.ClearAsync();
+        tree = std::move(rebuilt);
+        assert(rebuilt.root == nullptr && rebuilt.Size() == 0);
+        assert(tree.Size() == 2500);
+        assert(IsValidTree(tree));
+        assert(tree.Find(4998) && !tree.Find(7));
+        BTree<int, Order> moved(std::move(tree));
+        assert(moved.Size() == 2500 && tree.Size() == 0);
+
+        // marked keys are cleared along with the tree
+        moved.EnableLazyDelete();
+        moved.Delete(0);
+        assert(moved.Tombstones() == 1);
+        moved.ClearAsync();
+        assert(moved.Tombstones() == 0 && moved.Size() == 0);
+        moved.Insert(0);
+        assert(moved.Find(0));
+
+        // arena nodes freed by the drop thread return to the arena that made them
+        std::size_t before = 0;
+        for (const ArenaStats& stats : NodeArena::MemoryStats()) {
+            before += stats.used_bytes;
+        }
+        {
+            HugePageBTree<int, Order> arena_tree;
+            for (int i = 0; i < 5000; ++i) {
+                arena_tree.Insert(i);
+            }
+            arena_tree.ClearAsync();
+        }
+        AsyncDrop::Wait();
+        std::size_t after = 0;
+        for (const ArenaStats& stats : NodeArena::MemoryStats()) {
+            after += stats.used_bytes;
+        }
+        assert(after == before);
+    }
+
+    void TestLeafNodes() {
+        using Tree = BTree<int, Order>;
+        // leaves carry no child array
+        static_assert(sizeof(typename Tree::Node) < sizeof(typename Tree::InternalNode));
+        Tree tree;
+        assert(tree.Height() == 0);
+        int height = 0;
+        for (int i = 0; i < 3000; ++i) {
+            tree.Insert(i);
+            // the tree grows at the root, one level at a time
+            assert(tree.Height() == height || tree.Height() == height + 1);
+            height = tree.Height();
+        }
+        assert(height > 1);
+        assert(IsValidTree(tree));
+        const typename Tree::Node* node = tree.root.get();
+        for (int level = 0; level < height; ++level) {
+            assert(!node->IsLeaf());
+            node = node->Children().back().get();
+        }
+        assert(node->IsLeaf() && node->Children().empty());
+        for (int i = 0; i < 3000; ++i) {
+            tree.Delete(i);
+            assert(tree.Height() <= height);
+            height = tree.Height();
+            if (i % 100 == 0) assert(IsValidTree(tree));
+        }
+        assert(tree.root == nullptr && tree.Height() == 0);
+    }
+
+    void TestFlatSmallTrees() {
+        // the optional features sit behind one pointer, a small tree is little more than its keys
+        static_assert(sizeof(BTree<int, Order>) <= sizeof(std::vector<int>) + 6 * sizeof(void*));
+        BTree<int, Order> tree;
+        tree.SetFlatLimit(64);
+        std::vector<int> values;
+        for (int i = 0; i < 200; ++i) {
+            values.push_back(i * 3);
+        }
+        std::mt19937 g(41);
+        std::shuffle(values.begin(), values.end(), g);
+        for (int i = 0; i < 64; ++i) {
+            tree.Insert(values[i]);
+            tree.Insert(values[i]);
+        }
+        assert(tree.IsFlat() && tree.root == nullptr);
+        assert(tree.Size() == 64);
+        for (int i = 0; i < 200; ++i) {
+            assert(tree.Find(values[i]) == (i < 64));
+            assert(!tree.Find(values[i] + 1));
+            assert(tree.FindAsync(values[i]).Get() == (i < 64));
+        }
+        typename BTree<int, Order>::Cursor hint;
+        assert(tree.Find(hint, values[0]));
+
+        // one more key builds the nodes
+        tree.Insert(hint, values[64]);
+        assert(!tree.IsFlat() && tree.root != nullptr);
+        for (int i = 65; i < 200; ++i) {
+            tree.Insert(values[i]);
+        }
+        assert(IsValidTree(tree));
+        for (int i = 0; i < 200; ++i) {
+            assert(tree.Find(values[i]));
+        }
+
+        // and shrinking to half the limit drops them
+        for (int i = 0; i < 167; ++i) {
+            tree.Delete(values[i]);
+        }
+        assert(!tree.IsFlat());
+        tree.Delete(values[167]);
+        assert(tree.IsFlat() && tree.Size() == 32);
+        for (int i = 0; i < 200; ++i) {
+            assert(tree.Find(values[i]) == (i >= 168));
+        }
+        for (int i = 168; i < 200; ++i) {
+            tree.Delete(values[i]);
+        }
+        assert(tree.Size() == 0 && !tree.IsFlat() && tree.root == nullptr);
+
+        // lazy deletes mark flat keys like stored ones
+        tree.EnableLazyDelete(1.0);
+        tree.Insert(1);
+        tree.Insert(2);
+        tree.Delete(1);
+        assert(!tree.Find(1) && tree.Find(2) && tree.Size() == 1);
+        tree.Insert(1);
+        assert(tree.Find(1));
+
+        // lowering the limit builds the nodes at once
+        BTree<MoveOnlyKey, Order> move_only;
+        move_only.SetFlatLimit(16);
+        for (int i = 0; i < 16; ++i) {
+            move_only.Insert(MoveOnlyKey(i));
+        }
+        assert(move_only.IsFlat());
+        move_only.SetFlatLimit(8);
+        assert(!move_only.IsFlat());
+        assert(IsValidTree(move_only));
+        move_only.SetFlatLimit(40);
+        assert(move_only.IsFlat());
+        for (int i = 0; i < 16; ++i) {
+            assert(move_only.Find(MoveOnlyKey(i)));
+        }
+
+        // a cursor into the nodes goes stale when they are flattened and rebuilt
+        BTree<int, Order> hinted;
+        typename BTree<int, Order>::Cursor finger;
+        for (int i = 0; i < 100; ++i) {
+            hinted.Insert(finger, i);
+        }
+        hinted.SetFlatLimit(1000);
+        assert(hinted.IsFlat());
+        hinted.SetFlatLimit(0);
+        assert(!hinted.IsFlat());
+        assert(hinted.Find(finger, 50) && !hinted.Find(finger, 100));
+        hinted.Insert(finger, 100);
+        assert(hinted.Find(100) && IsValidTree(hinted));
+    }
+
+    void TestLookupFilter() {
+        BTree<int, Order> tree;
+        tree.EnableLookupFilter(0.01);
+        for (int i = 0; i < 20000; ++i) {
+            tree.Insert(i * 2);
+        }
+        assert(tree.LookupFilterStats().rebuilds > 0);
+        for (int i = 0; i < 20000; ++i) {
+            assert(tree.Find(i * 2));
+            assert(!tree.Find(i * 2 + 1));
+        }
+
+        // no false negatives, and about fpr false positives
+        FilterStats stats = tree.LookupFilterStats();
+        assert(stats.keys == 20000 && stats.expected_fpr < 0.03);
+        LookupFilter<int> filter(0.01, 0);
+        filter.Reset(20000);
+        for (int i = 0; i < 20000; ++i) {
+            filter.Add(i * 2);
+        }
+        std::size_t maybe = 0;
+        for (int i = 0; i < 20000; ++i) {
+            assert(filter.MayContain(i * 2));
+            maybe += filter.MayContain(i * 2 + 1) ? 1 : 0;
+        }
+        assert(maybe < 20000 * 0.02);
+
+        // deletes go stale until the filter is rebuilt from the keys
+        std::size_t rebuilds = tree.LookupFilterStats().rebuilds;
+        for (int i = 0; i < 15000; ++i) {
+            tree.Delete(i * 2);
+        }
+        assert(tree.LookupFilterStats().rebuilds > rebuilds);
+        assert(tree.LookupFilterStats().stale <= tree.LookupFilterStats().keys / 4 + 1);
+        for (int i = 0; i < 20000; ++i) {
+            assert(tree.Find(i * 2) == (i >= 15000));
+        }
+        assert(IsValidTree(tree));
+
+        // a byte cap wins over the rate
+        BTree<int, Order> capped;
+        capped.EnableLookupFilter(0.001, 4096);
+        for (int i = 0; i < 50000; ++i) {
+            capped.Insert(i);
+        }
+        assert(capped.LookupFilterStats().bytes <= 4096);
+        for (int i = 0; i < 50000; ++i) {
+            assert(capped.Find(i));
+        }
+
+        // flat trees, lazy deletes and enabling on a filled tree
+        BTree<int, Order> flat;
+        flat.SetFlatLimit(64);
+        for (int i = 0; i < 40; ++i) {
+            flat.Insert(i);
+        }
+        flat.EnableLazyDelete(1.0);
+        flat.EnableLookupFilter();
+        flat.Delete(3);
+        assert(!flat.Find(3) && flat.Find(4) && !flat.Find(100));
+        flat.Insert(3);
+        flat.Compact();
+        assert(flat.Find(3) && flat.IsFlat());
+        flat.Clear();
+        assert(!flat.Find(4) && flat.LookupFilterStats().keys == 0);
+        flat.Insert(4);
+        assert(flat.Find(4));
+        flat.DisableLookupFilter();
+        assert(flat.LookupFilterStats().bytes == 0 && flat.Find(4));
+
+        BTree<std::string, 3, TwoThreeKeys<std::string>> words;
+        words.EnableLookupFilter();
+        for (int i = 0; i < 1000; ++i) {
+            words.Insert(std::to_string(i));
+        }
+        for (int i = 0; i < 2000; ++i) {
+            assert(words.Find(std::to_string(i)) == (i < 1000));
+        }
+    }
+
+    // every model a node routes with was fitted to its current keys
+    template<typename Node>
+    bool RoutesFresh(const Node* node) {
+        if (node->route.quantity != node->keys.size()) return false;
+        for (const auto& child : node->Children()) {
+            if (!RoutesFresh(child.get())) return false;
+        }
+        return true;
+    }
+
+    template<typename Search>
+    void CheckSearch() {
+        // dense ids, then keys bunched at one end, where a straight line fits badly
+        for (int shape = 0; shape < 2; ++shape) {
+            BTree<std::int64_t, 64, SortedKeys<std::int64_t>, HeapNodes, Search> tree;
+            std::vector<std::int64_t> values;
+            for (std::int64_t i = 0; i < 20000; ++i) {
+                values.push_back(shape == 0 ? 1000 + i * 2 : i * i * i - 5000000);
+            }
+            std::mt19937 g(43 + shape);
+            std::shuffle(values.begin(), values.end(), g);
+            for (std::int64_t value : values) {
+                tree.Insert(value);
+            }
+            assert(IsValidTree(tree));
+            for (std::size_t i = 0; i < values.size(); i += 2) {
+                tree.Delete(values[i]);
+            }
+            assert(IsValidTree(tree) && tree.Size() == values.size() / 2);
+            if constexpr (std::is_same_v<Search, LearnedSearch>) {
+                assert(RoutesFresh(tree.root.get()));
+            }
+            std::vector<std::int64_t> kept;
+            for (std::size_t i = 1; i < values.size(); i += 2) {
+                kept.push_back(values[i]);
+            }
+            std::sort(kept.begin(), kept.end());
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                assert(tree.Find(values[i]) == (i % 2 == 1));
+                assert(tree.Find(values[i] + 1) == std::binary_search(kept.begin(), kept.end(), values[i] + 1));
+            }
+            assert(!tree.Find(INT64_MIN) && !tree.Find(INT64_MAX));
+        }
+
+        // a model left stale by a replaced key still finds every slot
+        SortedKeys<int> keys;
+        for (int i = 0; i < 40; ++i) {
+            keys.Insert(i * 10);
+        }
+        typename Search::Model model;
+        Search::Fit(model, keys);
+        keys.Replace(20, 199);
+        keys.Replace(0, -1000);
+        for (int key = -1100; key < 500; ++key) {
+            assert(Search::LowerBound(model, keys, key) == keys.LowerBound(key));
+        }
+
+        // keys without arithmetic fall back to the keys' own search
+        BTree<std::string, 8, SortedKeys<std::string>, HeapNodes, Search> words;
+        for (int i = 0; i < 500; ++i) {
+            words.Insert(std::to_string(i));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            assert(words.Find(std::to_string(i)) == (i < 500));
+        }
+    }
+
+    void TestSearchStrategies() {
+        CheckSearch<InterpolationSearch>();
+        CheckSearch<LearnedSearch>();
+    }
+
+    void TestHotIndex() {
+        // ranks of a lone index against std::lower_bound, across tier boundaries
+        for (int count : {1, 5, 16, 17, 256, 257, 5000}) {
+            HotIndex<int, int> index(2);
+            std::vector<int> separators;
+            std::vector<int> entries;
+            for (int i = 0; i < count; ++i) {
+                separators.push_back(i * 3);
+                entries.push_back(i);
+            }
+            entries.push_back(count);
+            index.Assign(separators, entries);
+            for (int key = -2; key < count * 3 + 2; ++key) {
+                auto rank = static_cast<std::size_t>(
+                    std::lower_bound(separators.begin(), separators.end(), key) - separators.begin());
+                assert(index.Rank(key) == rank);
+                assert(index.IsSeparator(rank, key) == (key % 3 == 0 && key >= 0 && key < count * 3));
+            }
+        }
+
+        for (int levels : {1, 2, 3}) {
+            BTree<int, Order> tree;
+            tree.EnableHotIndex(levels);
+            std::vector<int> values;
+            for (int i = 0; i < 30000; ++i) {
+                values.push_back(i * 2);
+            }
+            std::mt19937 g(44 + levels);
+            std::shuffle(values.begin(), values.end(), g);
+            // lookups between the inserts rebuild the index after every change on top
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                tree.Insert(values[i]);
+                if (i % 97 == 0) {
+                    assert(tree.Find(values[i / 2]) && !tree.Find(values[i / 2] + 1));
+                }
+            }
+            assert(tree.Height() >= levels && tree.HotIndexBytes() > 0);
+            for (int i = 0; i < 60000; ++i) {
+                assert(tree.Find(i) == (i % 2 == 0));
+                assert(tree.FindAsync(i).Get() == (i % 2 == 0));
+            }
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                if (i % 3 != 0) {
+                    tree.Delete(values[i]);
+                }
+                if (i % 101 == 0) {
+                    assert(!tree.Find(values[i]) == (i % 3 != 0));
+                }
+            }
+            assert(IsValidTree(tree));
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                assert(tree.Find(values[i]) == (i % 3 == 0));
+            }
+            typename BTree<int, Order>::Cursor hint;
+            for (int i = 1; i < 3000; i += 2) {
+                tree.Insert(hint, i);
+                assert(tree.Find(i));
+            }
+            tree.Clear();
+            assert(!tree.Find(0));
+            tree.Insert(7);
+            assert(tree.Find(7) && !tree.Find(8));
+        }
+
+        // no index over the leaves, every leaf split would make it stale
+        BTree<int, Order> shallow;
+        shallow.EnableHotIndex(1);
+        int key = 0;
+        while (shallow.Height() < 1) {
+            shallow.Insert(key++);
+        }
+        assert(shallow.Find(0) && shallow.HotIndexBytes() == 0);
+        while (shallow.Height() < 2) {
+            shallow.Insert(key++);
+        }
+        assert(shallow.Find(0) && shallow.HotIndexBytes() > 0);
+    }
+
+    void TestRangeAndLookup() {
+        for (std::size_t flat_limit : {0, 1000}) {
+            BTree<int, Order> tree;
+            tree.SetFlatLimit(flat_limit);
+            tree.EnableLazyDelete(1.0);
+            for (int i = 0; i < 600; ++i) {
+                tree.Insert(i * 2);
+            }
+            tree.Delete(100);
+            std::vector<int> visited;
+            tree.ForEachInRange(95, 111, [&visited](int key) {
+                visited.push_back(key);
+            });
+            assert((visited == std::vector<int>{96, 98, 102, 104, 106, 108, 110}));
+            visited.clear();
+            tree.ForEachInRange(-5, 3, [&visited](int key) {
+                visited.push_back(key);
+            });
+            assert((visited == std::vector<int>{0, 2}));
+            std::size_t all = 0;
+            tree.ForEachInRange(INT_MIN, INT_MAX, [&all](int) {
+                ++all;
+            });
+            assert(all == tree.Size());
+
+            assert(tree.Lookup(98) && *tree.Lookup(98) == 98);
+            assert(!tree.Lookup(99) && !tree.Lookup(100));
+        }
+    }
+
+    // keys in order, to check that Aggregate never swaps its operands
+    struct Sequence {
+        struct Value {
+            std::int64_t first = -1;
+            std::int64_t last = -1;
+            bool sorted = true;
+        };
+        static Value Identity() {
+            return Value();
+        }
+        static Value Of(const std::int64_t& key) {
+            return Value{key, key, true};
+        }
+        static Value Combine(const Value& left, const Value& right) {
+            if (left.first < 0) return right;
+            if (right.first < 0) return left;
+            return Value{left.first, right.last, left.sorted && right.sorted && left.last < right.first};
+        }
+    };
+
+    template<typename Tree>
+    void CheckAggregates(Tree& tree, const std::vector<std::int64_t>& kept, std::mt19937& g) {
+        for (int round = 0; round < 300; ++round) {
+            std::int64_t lo = static_cast<std::int64_t>(g() % 12000) - 500;
+            std::int64_t hi = lo + static_cast<std::int64_t>(g() % 3000);
+            auto first = std::lower_bound(kept.begin(), kept.end(), lo);
+            auto last = std::upper_bound(kept.begin(), kept.end(), hi);
+            std::int64_t sum = 0;
+            for (auto it = first; it != last; ++it) sum += *it;
+            auto [total, low, high, sequence] = tree.Aggregate(lo, hi);
+            assert(total == sum);
+            assert(low == (first == last ? INT64_MAX : *first));
+            assert(high == (first == last ? INT64_MIN : *(last - 1)));
+            assert(sequence.sorted && sequence.first == (first == last ? -1 : *first));
+        }
+    }
+
+    // sum, min, max and order of a range at once
+    struct Dashboard {
+        using Value = std::tuple<std::int64_t, std::int64_t, std::int64_t, typename Sequence::Value>;
+        static Value Identity() {
+            return {0, INT64_MAX, INT64_MIN, Sequence::Identity()};
+        }
+        static Value Of(const std::int64_t& key) {
+            return {key, key, key, Sequence::Of(key)};
+        }
+        static Value Combine(const Value& left, const Value& right) {
+            return {std::get<0>(left) + std::get<0>(right),
+                    MinOf<std::int64_t>::Combine(std::get<1>(left), std::get<1>(right)),
+                    MaxOf<std::int64_t>::Combine(std::get<2>(left), std::get<2>(right)),
+                    Sequence::Combine(std::get<3>(left), std::get<3>(right))};
+        }
+    };
+
+    void TestAggregate() {
+        using Tree = AugmentedBTree<std::int64_t, Order, Dashboard>;
+        std::mt19937 g(46);
+        for (std::size_t flat_limit : {0, 64}) {
+            Tree tree;
+            tree.SetFlatLimit(flat_limit);
+            std::vector<std::int64_t> values;
+            for (std::int64_t i = 0; i < 10000; ++i) {
+                values.push_back(i);
+            }
+            std::shuffle(values.begin(), values.end(), g);
+            typename Tree::Cursor hint;
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                if (i % 2 == 0) {
+                    tree.Insert(values[i]);
+                } else {
+                    tree.Insert(hint, values[i]);
+                }
+            }
+            std::vector<std::int64_t> kept(values.begin(), values.end());
+            std::sort(kept.begin(), kept.end());
+            CheckAggregates(tree, kept, g);
+
+            // deletes merge, rotate and swap keys out of internal nodes
+            for (std::size_t i = 0; i < values.size(); i += 3) {
+                tree.Delete(values[i]);
+            }
+            kept.clear();
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                if (i % 3 != 0) kept.push_back(values[i]);
+            }
+            std::sort(kept.begin(), kept.end());
+            assert(IsValidTree(tree));
+            CheckAggregates(tree, kept, g);
+            assert(std::get<0>(tree.Aggregate(5, 4)) == 0);
+
+            // lazily deleted keys drop out of the aggregates too
+            tree.EnableLazyDelete(1.0);
+            for (std::size_t i = 1; i < values.size(); i += 3) {
+                tree.Delete(values[i]);
+            }
+            kept.clear();
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                if (i % 3 == 2) kept.push_back(values[i]);
+            }
+            std::sort(kept.begin(), kept.end());
+            CheckAggregates(tree, kept, g);
+
+            // and down to the flat array
+            for (std::size_t i = 2; i < values.size(); i += 3) {
+                if (i > 90) tree.Delete(values[i]);
+            }
+            kept.clear();
+            for (std::size_t i = 2; i <= 90; i += 3) kept.push_back(values[i]);
+            std::sort(kept.begin(), kept.end());
+            CheckAggregates(tree, kept, g);
+        }
+
+        AugmentedBTree<int, Order, SumOf<int>> counts;
+        for (int i = 1; i <= 100; ++i) {
+            counts.Insert(i);
+        }
+        assert(counts.Aggregate(1, 100) == 5050 && counts.Aggregate(10, 19) == 145);
+    }
+
+    void TestPriorityQueue() {
+        BTree<int, Order> tree;
+        assert(!tree.Min() && !tree.Max() && !tree.PopMin() && !tree.PopMax());
+        assert(tree.PopMinBatch(3).empty());
+
+        // a scheduling queue: enqueue in random order, dequeue from both ends
+        tree.EnableHotIndex(1);
+        std::set<int> expected;
+        std::mt19937 g(47);
+        for (int round = 0; round < 60000; ++round) {
+            int op = static_cast<int>(g() % 8);
+            if (op < 4 || expected.empty()) {
+                int key = static_cast<int>(g() % 100000);
+                tree.Insert(key);
+                expected.insert(key);
+            } else if (op < 6) {
+                assert(*tree.Min() == *expected.begin());
+                assert(*tree.PopMin() == *expected.begin());
+                expected.erase(expected.begin());
+            } else if (op < 7) {
+                assert(*tree.Max() == *expected.rbegin());
+                assert(*tree.PopMax() == *expected.rbegin());
+                expected.erase(std::prev(expected.end()));
+            } else {
+                std::vector<int> batch = tree.PopMinBatch(g() % 20);
+                for (int key : batch) {
+                    assert(key == *expected.begin());
+                    expected.erase(expected.begin());
+                }
+            }
+            if (round % 5000 == 0) {
+                assert(IsValidTree(tree) && tree.Size() == expected.size());
+                assert(expected.empty() || tree.Find(*expected.begin()));
+            }
+        }
+        std::vector<int> rest = tree.PopMinBatch(expected.size() + 10);
+        assert(std::equal(rest.begin(), rest.end(), expected.begin(), expected.end()));
+        assert(tree.Size() == 0 && tree.root == nullptr && !tree.Min());
+        tree.Insert(5);
+        assert(*tree.Min() == 5 && *tree.Max() == 5);
+
+        // flat trees and lazily deleted keys
+        BTree<int, Order> small;
+        small.SetFlatLimit(16);
+        small.EnableLazyDelete(1.0);
+        for (int i = 0; i < 12; ++i) {
+            small.Insert(i);
+        }
+        small.Delete(0);
+        small.Delete(11);
+        assert(*small.Min() == 1 && *small.Max() == 10);
+        assert(*small.PopMin() == 1 && *small.PopMax() == 10 && small.Size() == 8);
+
+        // keys are moved out, and aggregates follow the pops
+        BTree<MoveOnlyKey, Order> move_only;
+        for (int i = 0; i < 300; ++i) {
+            move_only.Insert(MoveOnlyKey((i * 7) % 300));
+        }
+        for (int i = 0; i < 300; ++i) {
+            assert(*move_only.PopMin()->value == i);
+        }
+        AugmentedBTree<int, Order, SumOf<int>> sums;
+        for (int i = 1; i <= 1000; ++i) {
+            sums.Insert(i);
+        }
+        for (int i = 1; i <= 400; ++i) {
+            sums.PopMin();
+            sums.PopMax();
+            if (i % 50 == 0) {
+                assert(sums.Aggregate(0, 2000) == (i + 1 + 1000 - i) * (1000 - 2 * i) / 2);
+            }
+        }
+        assert(IsValidTree(sums));
+        // pops that leave the aggregate of the leaf as it was stop there
+        AugmentedBTree<int, Order, MaxOf<int>> maxes;
+        for (int i = 1; i <= 1000; ++i) {
+            maxes.Insert(i);
+        }
+        for (int i = 1; i <= 300; ++i) {
+            maxes.PopMin();
+            assert(maxes.Aggregate(0, 2000) == 1000 && maxes.Aggregate(0, 500) == 500);
+        }
+        for (int i = 1; i <= 300; ++i) {
+            maxes.PopMax();
+            assert(maxes.Aggregate(0, 2000) == 1000 - i && maxes.Aggregate(0, 350) == 350);
+        }
+
+        // batches spanning many leaves, in every kind of storage
+        std::vector<int> batch = sums.PopMinBatch(150);
+        assert(batch.size() == 150 && batch.front() == 401 && batch.back() == 550);
+        assert(IsValidTree(sums) && sums.Aggregate(0, 2000) == (551 + 600) * 50 / 2);
+        for (int i = 0; i < 300; ++i) {
+            move_only.Insert(MoveOnlyKey(i));
+        }
+        std::vector<MoveOnlyKey> moved = move_only.PopMinBatch(299);
+        assert(*moved.back().value == 298 && *move_only.Min()->value == 299);
+        BTree<std::int64_t, Order, FrameOfReferenceKeys<std::int64_t> > packed;
+        for (std::int64_t i = 0; i < 2000; ++i) {
+            packed.Insert(i * 3);
+        }
+        std::vector<std::int64_t> firsts = packed.PopMinBatch(1500);
+        assert(firsts.size() == 1500 && firsts.back() == 4497 && !packed.Find(4497) && packed.Find(4500));
+        assert(IsValidTree(packed) && packed.Size() == 500);
+        small.EnableLookupFilter();
+        std::vector<int> flat = small.PopMinBatch(100);
+        assert(flat.size() == 8 && flat.front() == 2 && small.Size() == 0 && !small.Find(5));
+    }
+
     void RunAllTests() {
         std::cout << "Running B-tree tests (Order = " << Order << ")...\n";
 
@@ -290,6 +1562,48 @@ public:
         std::cout << "TestDeleteNonExistent...OK\n";
         TestDeleteManyRandom();
         std::cout << "TestDeleteManyRandom...OK\n";
+        TestPrefixCompressedKeys();
+        std::cout << "TestPrefixCompressedKeys...OK\n";
+        TestFrameOfReferenceKeys();
+        std::cout << "TestFrameOfReferenceKeys...OK\n";
+        TestHybridKeys();
+        std::cout << "TestHybridKeys...OK\n";
+        TestHybridSetOperations();
+        std::cout << "TestHybridSetOperations...OK\n";
+        TestRuntimeOrder();
+        std::cout << "TestRuntimeOrder...OK\n";
+        TestFingerOperations();
+        std::cout << "TestFingerOperations...OK\n";
+        TestMoveOnlyKeys();
+        std::cout << "TestMoveOnlyKeys...OK\n";
+        TestRedistribution();
+        std::cout << "TestRedistribution...OK\n";
+        TestLazyDelete();
+        std::cout << "TestLazyDelete...OK\n";
+        TestFindAsync();
+        std::cout << "TestFindAsync...OK\n";
+        TestHugePageNodes();
+        std::cout << "TestHugePageNodes...OK\n";
+        TestProfiler();
+        std::cout << "TestProfiler...OK\n";
+        TestClear();
+        std::cout << "TestClear...OK\n";
+        TestLeafNodes();
+        std::cout << "TestLeafNodes...OK\n";
+        TestFlatSmallTrees();
+        std::cout << "TestFlatSmallTrees...OK\n";
+        TestLookupFilter();
+        std::cout << "TestLookupFilter...OK\n";
+        TestSearchStrategies();
+        std::cout << "TestSearchStrategies...OK\n";
+        TestHotIndex();
+        std::cout << "TestHotIndex...OK\n";
+        TestRangeAndLookup();
+        std::cout << "TestRangeAndLookup...OK\n";
+        TestAggregate();
+        std::cout << "TestAggregate...OK\n";
+        TestPriorityQueue();
+        std::cout << "TestPriorityQueue...OK\n";
 
         std::cout << "✅ All B-tree tests passed!\n";
     }
@@ -0,0 +1,212 @@
+#ifndef MY_TEST_BE_TREE
+#define MY_TEST_BE_TREE
+
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <random>
+#include <set>
+#include <string>
+#include "be_tree.h"
+
+template<typename KeyType, int Order>
+class TestBeTree {
+private:
+    using Tree = BeTree<KeyType, Order>;
+    using Node = typename Tree::Node;
+
+    static constexpr std::size_t kBufferSize = 8 * Order;
+
+    // Helper: validate a subtree holding keys in [min_val, max_val), a null bound means unbounded.
+    // Sets depth to the number of levels below node.
+    bool ValidateNode(const Node* node, const KeyType* min_val, const KeyType* max_val, bool is_root, int& depth) {
+        const auto& keys = node->keys;
+        const auto& childs = node->childs;
+
+        for (size_t i = 1; i < keys.size(); ++i) {
+            if (!(keys[i - 1] < keys[i])) return false;
+        }
+        for (const auto& key : keys) {
+            if ((min_val && key < *min_val) || (max_val && !(key < *max_val))) return false;
+        }
+
+        if (childs.empty()) {
+            depth = 0;
+            if (!node->buffer.empty()) return false;
+            if (keys.empty() || keys.size() > static_cast<size_t>(Order - 1)) return false;
+            return is_root || keys.size() >= static_cast<size_t>((Order - 1) / 2);
+        }
+
+        // Internal node: between ceil(Order / 2) (2 for root) and Order children
+        if (childs.size() != keys.size() + 1 || childs.size() > static_cast<size_t>(Order)) return false;
+        if (childs.size() < (is_root ? 2 : static_cast<size_t>((Order + 1) / 2))) return false;
+
+        // Buffer: strictly increasing, bounded, inside the node range
+        const auto& buffer = node->buffer;
+        if (buffer.size() > kBufferSize) return false;
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            if (i > 0 && !(buffer[i - 1].key < buffer[i].key)) return false;
+            if ((min_val && buffer[i].key < *min_val) || (max_val && !(buffer[i].key < *max_val))) return false;
+        }
+
+        int child_depth = -1;
+        for (size_t i = 0; i < childs.size(); ++i) {
+            int d = 0;
+            const KeyType* lo = i == 0 ? min_val : &keys[i - 1];
+            const KeyType* hi = i == keys.size() ? max_val : &keys[i];
+            if (!ValidateNode(childs[i].get(), lo, hi, false, d)) return false;
+            // All leaves on the same level
+            if (child_depth != -1 && d != child_depth) return false;
+            child_depth = d;
+        }
+        depth = child_depth + 1;
+        return true;
+    }
+
+    bool IsValidTree(const Tree& tree) {
+        if (!tree.root) return true;
+        int depth = 0;
+        return ValidateNode(tree.root.get(), nullptr, nullptr, true, depth);
+    }
+
+    bool HasPendingMessages(const Node* node) {
+        if (!node->buffer.empty()) return true;
+        for (const auto& child : node->childs) {
+            if (HasPendingMessages(child.get())) return true;
+        }
+        return false;
+    }
+
+    size_t CountLeafKeys(const Node* node) {
+        if (node->childs.empty()) return node->keys.size();
+        size_t count = 0;
+        for (const auto& child : node->childs) {
+            count += CountLeafKeys(child.get());
+        }
+        return count;
+    }
+
+public:
+    void TestEmptyTree() {
+        Tree tree;
+        assert(!tree.Find(42));
+        tree.Delete(42);
+        assert(tree.root == nullptr);
+        assert(IsValidTree(tree));
+    }
+
+    void TestInsertBasic() {
+        Tree tree;
+        for (int i = 1; i < Order; ++i) {
+            tree.Insert(i * 10);
+        }
+        // a single leaf applies updates directly
+        assert(tree.root->childs.empty());
+        for (int i = 1; i < Order; ++i) {
+            assert(tree.Find(i * 10));
+        }
+        assert(!tree.Find(5));
+        tree.Insert(10);
+        assert(tree.root->keys.size() == static_cast<size_t>(Order - 1));
+        assert(IsValidTree(tree));
+    }
+
+    void TestBufferedUpdates() {
+        Tree tree;
+        for (int i = 1; i <= Order; ++i) {
+            tree.Insert(i * 10);
+        }
+        assert(!tree.root->childs.empty());
+
+        // later updates wait in the root buffer and win over the leaves
+        tree.Insert(15);
+        tree.Delete(20);
+        assert(tree.root->buffer.size() == 2);
+        assert(tree.Find(15));
+        assert(!tree.Find(20));
+        tree.Insert(20);
+        tree.Delete(15);
+        assert(tree.root->buffer.size() == 2);
+        assert(!tree.Find(15));
+        assert(tree.Find(20));
+        assert(IsValidTree(tree));
+
+        tree.Flush();
+        assert(!HasPendingMessages(tree.root.get()));
+        assert(CountLeafKeys(tree.root.get()) == static_cast<size_t>(Order));
+        assert(!tree.Find(15));
+        assert(tree.Find(20));
+        assert(IsValidTree(tree));
+    }
+
+    void TestManyRandom() {
+        Tree tree;
+        std::set<int> expected;
+        std::mt19937 g(33);
+        std::uniform_int_distribution<int> dist(0, 3000);
+        for (int i = 0; i < 20000; ++i) {
+            int key = dist(g);
+            // insert-heavy first half, delete-heavy second half
+            if (g() % 4 < (i < 10000 ? 3u : 1u)) {
+                tree.Insert(key);
+                expected.insert(key);
+            } else {
+                tree.Delete(key);
+                expected.erase(key);
+            }
+            if (i % 1000 == 0) {
+                assert(IsValidTree(tree));
+            }
+        }
+        assert(IsValidTree(tree));
+        for (int key = 0; key <= 3000; ++key) {
+            assert(tree.Find(key) == (expected.count(key) == 1));
+        }
+        assert(tree.Stats().splits > 0);
+
+        // most deletes may still wait in the buffers
+        tree.Flush();
+        assert(tree.Stats().merges > 0);
+        assert(IsValidTree(tree));
+        assert(!HasPendingMessages(tree.root.get()));
+        assert(CountLeafKeys(tree.root.get()) == expected.size());
+
+        for (int key : std::set<int>(expected)) {
+            tree.Delete(key);
+        }
+        tree.Flush();
+        assert(tree.root == nullptr);
+    }
+
+    void TestStringKeys() {
+        BeTree<std::string, Order> tree;
+        for (int i = 0; i < 500; ++i) {
+            tree.Insert("key_" + std::to_string(i));
+        }
+        for (int i = 0; i < 500; i += 2) {
+            tree.Delete("key_" + std::to_string(i));
+        }
+        for (int i = 0; i < 500; ++i) {
+            assert(tree.Find("key_" + std::to_string(i)) == (i % 2 == 1));
+        }
+    }
+
+    void RunAllTests() {
+        std::cout << "Running B-epsilon tree tests (Order = " << Order << ")...\n";
+
+        TestEmptyTree();
+        std::cout << "TestEmptyTree...OK\n";
+        TestInsertBasic();
+        std::cout << "TestInsertBasic...OK\n";
+        TestBufferedUpdates();
+        std::cout << "TestBufferedUpdates...OK\n";
+        TestManyRandom();
+        std::cout << "TestManyRandom...OK\n";
+        TestStringKeys();
+        std::cout << "TestStringKeys...OK\n";
+
+        std::cout << "✅ All B-epsilon tree tests passed!\n";
+    }
+};
+
+#endif
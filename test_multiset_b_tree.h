@@ -0,0 +1,130 @@
+#ifndef MY_TEST_MULTISET_B_TREE
+#define MY_TEST_MULTISET_B_TREE
+
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <random>
+#include <map>
+#include <string>
+#include "multiset_b_tree.h"
+
+template<int Order>
+class TestMultisetBTree {
+private:
+    using Tree = MultisetBTree<int, Order>;
+
+public:
+    void TestCounts() {
+        Tree tree;
+        assert(tree.Count(5) == 0 && !tree.EraseOne(5) && tree.EraseAll(5) == 0);
+        tree.InsertDup(5);
+        tree.InsertDup(5);
+        tree.InsertDup(7, 3);
+        tree.InsertDup(9, 0);
+        assert(tree.Count(5) == 2 && tree.Count(7) == 3 && tree.Count(9) == 0);
+        assert(tree.Size() == 2 && tree.TotalCount() == 5);
+        assert(tree.EraseOne(5) && tree.Count(5) == 1 && tree.Contains(5));
+        assert(tree.EraseOne(5) && tree.Count(5) == 0 && !tree.Contains(5));
+        assert(tree.EraseAll(7) == 3 && tree.Size() == 0 && tree.TotalCount() == 0);
+    }
+
+    // counts survive the splits, merges and rotations of a large tree
+    void TestAgainstMap() {
+        Tree tree;
+        std::map<int, std::size_t> expected;
+        std::mt19937 g(45);
+        for (int i = 0; i < 40000; ++i) {
+            int key = static_cast<int>(g() % 3000);
+            switch (g() % 4) {
+                case 0:
+                case 1:
+                    tree.InsertDup(key);
+                    ++expected[key];
+                    break;
+                case 2:
+                    assert(tree.EraseOne(key) == (expected.count(key) > 0));
+                    if (expected.count(key) > 0 && --expected[key] == 0) {
+                        expected.erase(key);
+                    }
+                    break;
+                default:
+                    if (g() % 8 == 0) {
+                        std::size_t count = expected.count(key) > 0 ? expected[key] : 0;
+                        assert(tree.EraseAll(key) == count);
+                        expected.erase(key);
+                    } else {
+                        tree.InsertDup(key, 5);
+                        expected[key] += 5;
+                    }
+            }
+        }
+        std::size_t total = 0;
+        for (int key = -1; key <= 3000; ++key) {
+            std::size_t count = expected.count(key) > 0 ? expected[key] : 0;
+            assert(tree.Count(key) == count);
+            total += count;
+        }
+        assert(tree.Size() == expected.size() && tree.TotalCount() == total);
+
+        for (int lo = -10; lo < 3010; lo += 37) {
+            int hi = lo + static_cast<int>(g() % 400);
+            std::size_t sum = 0;
+            for (auto it = expected.lower_bound(lo); it != expected.end() && it->first <= hi; ++it) {
+                sum += it->second;
+            }
+            assert(tree.CountRange(lo, hi) == sum);
+        }
+        assert(tree.CountRange(10, 5) == 0);
+
+        std::vector<std::pair<int, std::size_t>> visited;
+        tree.ForEachInRange(100, 200, [&visited](int key, std::size_t count) {
+            visited.emplace_back(key, count);
+        });
+        std::vector<std::pair<int, std::size_t>> in_map(expected.lower_bound(100), expected.upper_bound(200));
+        assert(visited == in_map);
+    }
+
+    // the options of the tree underneath see one key per distinct value
+    void TestUnderlyingOptions() {
+        Tree tree;
+        tree.Underlying().SetFlatLimit(32);
+        tree.Underlying().EnableLookupFilter();
+        tree.Underlying().EnableHotIndex(1);
+        static_assert(!requires(typename Tree::Tree& underlying) { underlying.EnableLazyDelete(); });
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 2000; ++i) {
+                tree.InsertDup(i % 500);
+            }
+        }
+        for (int i = 0; i < 600; ++i) {
+            assert(tree.Count(i) == (i < 500 ? 12u : 0u));
+        }
+        assert(tree.CountRange(0, 9) == 120);
+        for (int i = 0; i < 500; ++i) {
+            tree.EraseAll(i);
+        }
+        assert(tree.Size() == 0 && tree.Underlying().root == nullptr);
+
+        MultisetBTree<std::string, Order> words;
+        for (const char* word : {"b", "a", "b", "c", "b"}) {
+            words.InsertDup(word);
+        }
+        assert(words.Count("b") == 3 && words.CountRange("a", "b") == 4);
+    }
+
+    void RunAllTests() {
+        std::cout << "Running multiset B-tree tests (Order = " << Order << ")...\n";
+
+        TestCounts();
+        std::cout << "TestCounts...OK\n";
+        TestAgainstMap();
+        std::cout << "TestAgainstMap...OK\n";
+        TestUnderlyingOptions();
+        std::cout << "TestUnderlyingOptions...OK\n";
+
+        std::cout << "✅ All multiset B-tree tests passed!\n";
+    }
+};
+
+#endif
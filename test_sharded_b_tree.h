@@ -0,0 +1,177 @@
+#ifndef MY_TEST_SHARDED_B_TREE
+#define MY_TEST_SHARDED_B_TREE
+
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include "sharded_b_tree.h"
+
+template<int Order>
+class TestShardedBTree {
+private:
+    using Tree = ShardedBTree<int, Order>;
+
+    template<typename Node>
+    void CollectKeys(const Node* node, std::vector<int>& keys) {
+        if (!node) return;
+        for (size_t i = 0; i < node->keys.size(); ++i) {
+            if (!node->Children().empty()) CollectKeys(node->Children()[i].get(), keys);
+            keys.push_back(node->keys[i]);
+        }
+        if (!node->Children().empty()) CollectKeys(node->Children().back().get(), keys);
+    }
+
+    // Every shard holds exactly the keys between its split points
+    bool ShardsMatchSplits(Tree& tree, size_t shards) {
+        std::vector<int> splits = tree.SplitPoints();
+        for (size_t i = 0; i < shards; ++i) {
+            std::vector<int> keys;
+            CollectKeys(tree.ShardTree(i).root.get(), keys);
+            if (keys.size() != tree.ShardSizes()[i]) return false;
+            for (int key : keys) {
+                if (i > 0 && (i > splits.size() || key < splits[i - 1])) return false;
+                if (i < splits.size() && !(key < splits[i])) return false;
+            }
+        }
+        return true;
+    }
+
+    static size_t ArenaUsedBytes() {
+        size_t bytes = 0;
+        for (const ArenaStats& stats : NodeArena::MemoryStats()) {
+            bytes += stats.used_bytes;
+        }
+        return bytes;
+    }
+
+public:
+    void TestSingleThread() {
+        Tree tree(4, {0, 250, 500, 750, 1000});
+        for (int i = 0; i < 1000; ++i) {
+            tree.Insert(i);
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            tree.Delete(i);
+        }
+        // Find is queued behind the updates of the same caller
+        for (int i = 0; i < 1000; ++i) {
+            assert(tree.Find(i) == (i % 2 == 1));
+        }
+        tree.Sync();
+        assert(tree.Size() == 500);
+        assert(tree.SplitPoints().size() == 3);
+        assert(ShardsMatchSplits(tree, 4));
+        for (size_t size : tree.ShardSizes()) {
+            assert(size > 0);
+        }
+
+        // workers build their shards in the arenas of their threads
+        size_t before = ArenaUsedBytes();
+        {
+            Tree arena_tree(2);
+            for (int i = 0; i < 1000; ++i) {
+                arena_tree.Insert(i);
+            }
+            arena_tree.Sync();
+            assert(ArenaUsedBytes() > before);
+        }
+        assert(ArenaUsedBytes() == before);
+    }
+
+    void TestConcurrentWriters() {
+        const int kThreads = 4;
+        const int kPerThread = 5000;
+        Tree tree(4);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < kThreads; ++t) {
+            writers.emplace_back([&tree, t] {
+                std::mt19937 g(t);
+                std::vector<int> keys;
+                for (int i = 0; i < kPerThread; ++i) {
+                    keys.push_back(i * kThreads + t);
+                }
+                std::shuffle(keys.begin(), keys.end(), g);
+                for (int key : keys) {
+                    tree.Insert(key);
+                }
+                for (int key : keys) {
+                    if (key % 3 == 0) tree.Delete(key);
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        tree.Sync();
+        int expected = 0;
+        for (int key = 0; key < kThreads * kPerThread; ++key) {
+            if (key % 3 != 0) ++expected;
+        }
+        assert(tree.Size() == static_cast<size_t>(expected));
+        assert(ShardsMatchSplits(tree, 4));
+        for (int key = 0; key < kThreads * kPerThread; key += 7) {
+            assert(tree.Find(key) == (key % 3 != 0));
+        }
+    }
+
+    void TestRebalanceOnSkew() {
+        // all keys start in the first shard without a sample
+        Tree tree(4);
+        for (int i = 0; i < 20000; ++i) {
+            tree.Insert(i);
+        }
+        tree.Sync();
+        assert(tree.Rebalances() > 0);
+        assert(ShardsMatchSplits(tree, 4));
+        std::vector<size_t> sizes = tree.ShardSizes();
+        size_t largest = *std::max_element(sizes.begin(), sizes.end());
+        assert(largest <= 2 * tree.Size() / 4 + 1024);
+
+        // explicit rebalance splits evenly
+        tree.Rebalance();
+        for (size_t size : tree.ShardSizes()) {
+            assert(size == 20000 / 4);
+        }
+        assert(ShardsMatchSplits(tree, 4));
+        for (int i = 0; i < 20000; i += 97) {
+            assert(tree.Find(i));
+        }
+
+        // shards whose range stays put keep their trees
+        std::vector<const void*> roots;
+        for (size_t i = 0; i < 4; ++i) {
+            roots.push_back(tree.ShardTree(i).root.get());
+        }
+        tree.Rebalance();
+        for (size_t i = 0; i < 4; ++i) {
+            assert(tree.ShardTree(i).root.get() == roots[i]);
+        }
+        assert(tree.Size() == 20000 && ShardsMatchSplits(tree, 4));
+
+        // shards left without a range hand all their keys over
+        for (int i = 0; i < 19998; ++i) {
+            tree.Delete(i);
+        }
+        tree.Rebalance();
+        assert(tree.Size() == 2 && tree.SplitPoints() == std::vector<int>{19999});
+        assert(ShardsMatchSplits(tree, 4) && tree.Find(19998) && tree.Find(19999));
+    }
+
+    void RunAllTests() {
+        std::cout << "Running sharded B-tree tests (Order = " << Order << ")...\n";
+
+        TestSingleThread();
+        std::cout << "TestSingleThread...OK\n";
+        TestConcurrentWriters();
+        std::cout << "TestConcurrentWriters...OK\n";
+        TestRebalanceOnSkew();
+        std::cout << "TestRebalanceOnSkew...OK\n";
+
+        std::cout << "✅ All sharded B-tree tests passed!\n";
+    }
+};
+
+#endif
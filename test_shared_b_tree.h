@@ -0,0 +1,299 @@
+#ifndef MY_TEST_SHARED_B_TREE
+#define MY_TEST_SHARED_B_TREE
+
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <random>
+#include <set>
+#include <chrono>
+#include <limits>
+#include <cerrno>
+#include <string>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "shared_b_tree.h"
+
+namespace shared_b_tree_test {
+
+// Key whose comparisons kill the process once armed: the comparison number
+// fuse dies, wherever the update it is part of stands.
+struct FatalKey {
+    int value;
+
+    static inline bool armed = false;
+    static inline int fuse = 0;
+
+    bool operator<(const FatalKey& other) const {
+        if (armed && fuse-- == 0) {
+            _exit(0);
+        }
+        return value < other.value;
+    }
+    bool operator==(const FatalKey& other) const {
+        return value == other.value;
+    }
+};
+
+}  // namespace shared_b_tree_test
+
+template<int Order>
+class TestSharedBTree {
+private:
+    using Tree = SharedBTree<int, Order>;
+
+    static std::string SegmentName(const std::string& test) {
+        return "/two_three_b_tree_" + std::to_string(getpid()) + "_" + test;
+    }
+
+public:
+    void TestSingleProcess() {
+        std::string name = SegmentName("single");
+        Tree tree = Tree::Create(name, 1 << 20);
+        std::set<int> expected;
+        std::mt19937 g(3);
+        for (int i = 0; i < 20000; ++i) {
+            int v = static_cast<int>(g() % 5000);
+            if (g() % 3 != 0) {
+                tree.Insert(v);
+                expected.insert(v);
+            } else {
+                tree.Delete(v);
+                expected.erase(v);
+            }
+        }
+        assert(tree.Size() == expected.size());
+        for (int v = 0; v < 5000; ++v) {
+            assert(tree.Find(v) == (expected.count(v) > 0));
+        }
+
+        // a second mapping reads the same nodes, and may not write them
+        Tree reader = Tree::Open(name);
+        assert(!reader.IsWriter() && reader.Size() == expected.size());
+        for (int v = 0; v < 5000; ++v) {
+            assert(reader.Find(v) == (expected.count(v) > 0));
+        }
+        bool refused = false;
+        try {
+            reader.Insert(1);
+        } catch (const std::logic_error&) {
+            refused = true;
+        }
+        assert(refused);
+        refused = false;
+        try {
+            Tree second_writer = Tree::Open(name, true);
+        } catch (const std::system_error&) {
+            refused = true;
+        }
+        assert(refused);
+
+        // freed nodes are reused
+        std::size_t used = tree.UsedBytes();
+        for (int v : expected) {
+            tree.Delete(v);
+        }
+        assert(tree.Size() == 0 && tree.Height() == 0 && !reader.Find(*expected.begin()));
+        for (int v = 0; v < 1000; ++v) {
+            tree.Insert(v);
+        }
+        assert(tree.UsedBytes() == used && reader.Size() == 1000 && reader.Find(999));
+
+        // an existing segment is only replaced on request
+        int error = 0;
+        try {
+            Tree::Create(name, 1 << 20);
+        } catch (const std::system_error& e) {
+            error = e.code().value();
+        }
+        assert(error == EEXIST && reader.Find(999));
+        Tree replaced = Tree::Create(name, 1 << 20, true);
+        assert(replaced.Size() == 0 && !Tree::Open(name).Find(999));
+        Tree::Unlink(name);
+
+        // a segment that cannot be sized or mapped is not left behind
+        std::string huge = SegmentName("huge");
+        bool failed = false;
+        try {
+            Tree::Create(huge, std::numeric_limits<std::size_t>::max() / 2);
+        } catch (const std::system_error&) {
+            failed = true;
+        }
+        error = 0;
+        try {
+            Tree::Open(huge);
+        } catch (const std::system_error& e) {
+            error = e.code().value();
+        }
+        assert(failed && error == ENOENT);
+    }
+
+    // readers give up on a segment whose writer died inside an update, and
+    // the next writer rolls the update back
+    void TestDeadWriter() {
+        using Fatal = SharedBTree<shared_b_tree_test::FatalKey, Order>;
+        std::string name = SegmentName("dead");
+        std::set<int> expected;
+        {
+            Fatal tree = Fatal::Create(name, 1 << 20);
+            for (int v = 0; v < 2000; v += 2) {
+                tree.Insert({v});
+                expected.insert(v);
+            }
+        }
+        Fatal reader = Fatal::Open(name);
+        bool timed_out = false;
+        std::mt19937 g(49);
+        // die at every point of the search and update, over enough keys that
+        // some of the updates split or merge before
+        for (int round = 0; round < 600; ++round) {
+            int fuse = round % 30;
+            int key = static_cast<int>(g() % 2000);
+            std::cout.flush();
+            pid_t pid = fork();
+            assert(pid >= 0);
+            if (pid == 0) {
+                Fatal writer = Fatal::Open(name, true);
+                shared_b_tree_test::FatalKey::armed = true;
+                shared_b_tree_test::FatalKey::fuse = fuse;
+                if (expected.count(key) > 0) {
+                    writer.Delete({key});
+                } else {
+                    writer.Insert({key});
+                }
+                _exit(1);
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+            assert(WIFEXITED(status));
+            bool died = WEXITSTATUS(status) == 0;
+            if (died && !timed_out) {
+                try {
+                    reader.Find({key}, std::chrono::milliseconds(20));
+                } catch (const std::system_error& e) {
+                    timed_out = e.code().value() == ETIMEDOUT;
+                }
+            }
+            Fatal writer = Fatal::Open(name, true);
+            if (!died) {
+                // the update went through
+                if (expected.count(key) > 0) {
+                    expected.erase(key);
+                } else {
+                    expected.insert(key);
+                }
+            }
+            assert(writer.Size() == expected.size());
+            for (int v = -1; v <= 2000; ++v) {
+                assert(reader.Find({v}) == (expected.count(v) > 0));
+            }
+        }
+        assert(timed_out && reader.Retries() > 0);
+
+        // the rolled back tree takes updates again
+        Fatal writer = Fatal::Open(name, true);
+        for (int v = 0; v < 2000; ++v) {
+            if (v % 3 == 0) {
+                writer.Insert({v});
+                expected.insert(v);
+            } else {
+                writer.Delete({v});
+                expected.erase(v);
+            }
+        }
+        assert(reader.Size() == expected.size());
+        for (int v = 0; v < 2000; ++v) {
+            assert(reader.Find({v}) == (expected.count(v) > 0));
+        }
+        Fatal::Unlink(name);
+    }
+
+    void TestFullSegment() {
+        std::string name = SegmentName("full");
+        Tree tree = Tree::Create(name, 4096);
+        int inserted = 0;
+        try {
+            for (;; ++inserted) {
+                tree.Insert(inserted);
+            }
+        } catch (const std::bad_alloc&) {
+        }
+        assert(inserted > 0 && tree.Size() == static_cast<std::size_t>(inserted));
+        assert(tree.UsedBytes() <= tree.Capacity());
+        for (int v = 0; v < inserted; ++v) {
+            assert(tree.Find(v));
+        }
+        // a failed insert leaves no update open
+        Tree reader = Tree::Open(name);
+        assert(reader.Find(0) && !reader.Find(inserted));
+        tree.Delete(0);
+        assert(!reader.Find(0) && reader.Size() == static_cast<std::size_t>(inserted - 1));
+        Tree::Unlink(name);
+    }
+
+    // forked readers search while the writer inserts and deletes
+    void TestConcurrentReaders() {
+        const int N = 20000;
+        std::string name = SegmentName("concurrent");
+        Tree tree = Tree::Create(name, 4 << 20);
+        for (int v = 0; v < N; v += 2) {
+            tree.Insert(v);
+        }
+        std::cout.flush();
+        std::vector<pid_t> readers;
+        for (int r = 0; r < 2; ++r) {
+            pid_t pid = fork();
+            assert(pid >= 0);
+            if (pid == 0) {
+                Tree reader = Tree::Open(name);
+                bool ok = true;
+                // the even keys stay put through every update
+                while (ok && reader.Size() != static_cast<std::size_t>(N)) {
+                    for (int v = 0; v < N && ok; v += 2) {
+                        ok = reader.Find(v);
+                    }
+                }
+                for (int v = 0; v < N && ok; ++v) {
+                    ok = reader.Find(v);
+                }
+                _exit(ok ? 0 : 1);
+            }
+            readers.push_back(pid);
+        }
+        std::mt19937 g(9);
+        for (int v = 1; v < N; v += 2) {
+            tree.Insert(v);
+            tree.Insert(N + static_cast<int>(g() % N));
+        }
+        for (int v = N; v < 2 * N; ++v) {
+            tree.Delete(v);
+        }
+        for (pid_t pid : readers) {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+        assert(tree.Size() == static_cast<std::size_t>(N));
+        Tree::Unlink(name);
+    }
+
+    void RunAllTests() {
+        std::cout << "Running shared B-tree tests (Order = " << Order << ")...\n";
+
+        TestSingleProcess();
+        std::cout << "TestSingleProcess...OK\n";
+        TestFullSegment();
+        std::cout << "TestFullSegment...OK\n";
+        TestConcurrentReaders();
+        std::cout << "TestConcurrentReaders...OK\n";
+        TestDeadWriter();
+        std::cout << "TestDeadWriter...OK\n";
+
+        std::cout << "✅ All shared B-tree tests passed!\n";
+    }
+};
+
+#endif
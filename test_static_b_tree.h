@@ -0,0 +1,79 @@
+#ifndef MY_TEST_STATIC_B_TREE
+#define MY_TEST_STATIC_B_TREE
+
+#include <iostream>
+#include <cassert>
+#include <array>
+#include <random>
+#include <set>
+#include <string_view>
+#include "static_b_tree.h"
+
+namespace static_b_tree_test {
+
+constexpr std::array<int, 12> kReservedIds = {40, 7, 1000, 3, 512, 7, 99, -5, 64, 8, 2048, 1};
+
+// every even number below 2 * N, in reverse
+template <std::size_t N>
+constexpr std::array<int, N> Evens() {
+    std::array<int, N> keys{};
+    for (std::size_t i = 0; i < N; ++i) {
+        keys[i] = static_cast<int>(2 * (N - 1 - i));
+    }
+    return keys;
+}
+
+}  // namespace static_b_tree_test
+
+template<int Order>
+class TestStaticBTree {
+public:
+    void TestCompileTime() {
+        using static_b_tree_test::kReservedIds;
+        constexpr StaticBTree<int, 12, Order> reserved(kReservedIds);
+        static_assert(reserved.Size() == 11);
+        static_assert(reserved.Find(7) && reserved.Find(-5) && reserved.Find(2048) && reserved.Find(1));
+        static_assert(!reserved.Find(0) && !reserved.Find(6) && !reserved.Find(4096) && !reserved.Find(-6));
+
+        constexpr StaticBTree<std::string_view, 5, Order> routes(std::array<std::string_view, 5>{
+            "/api", "/static", "/health", "/login", "/metrics"});
+        static_assert(routes.Find("/health") && !routes.Find("/admin"));
+
+        constexpr StaticBTree<int, 0, Order> empty(std::array<int, 0>{});
+        static_assert(empty.Size() == 0 && !empty.Find(0));
+    }
+
+    void TestRunTime() {
+        static constexpr StaticBTree<int, 1000, Order> evens(static_b_tree_test::Evens<1000>());
+        assert(evens.Size() == 1000);
+        for (int v = -3; v < 2003; ++v) {
+            assert(evens.Find(v) == (v >= 0 && v < 2000 && v % 2 == 0));
+        }
+
+        std::mt19937 g(17);
+        std::array<int, 777> keys{};
+        std::set<int> expected;
+        for (int& key : keys) {
+            key = static_cast<int>(g() % 1500);
+            expected.insert(key);
+        }
+        StaticBTree<int, 777, Order> tree(keys);
+        assert(tree.Size() == expected.size());
+        for (int v = -1; v < 1501; ++v) {
+            assert(tree.Find(v) == (expected.count(v) > 0));
+        }
+    }
+
+    void RunAllTests() {
+        std::cout << "Running static B-tree tests (Order = " << Order << ")...\n";
+
+        TestCompileTime();
+        std::cout << "TestCompileTime...OK\n";
+        TestRunTime();
+        std::cout << "TestRunTime...OK\n";
+
+        std::cout << "✅ All static B-tree tests passed!\n";
+    }
+};
+
+#endif
@@ -5,7 +5,9 @@
 #include <cassert>
 #include <vector>
 #include <random>
+#include <string>
 #include "two_three_tree.h"
+#include "find_task.h"
 
 class TestTwoThreeTree {
 private:
@@ -14,7 +16,7 @@ private:
         if (!node) return true;
 
         const auto& keys = node->keys;
-        const auto& childs = node->childs;
+        const auto& childs = node->Children();
 
         // 2-3 Tree node must have 1 or 2 keys
         if (keys.size() != 1 && keys.size() != 2) {
@@ -89,7 +91,7 @@ public:
 
         // After split: root is 2-node with middle key, two children
         assert(tree.root->keys.size() == 1);
-        assert(tree.root->childs.size() == 2);
+        assert(tree.root->Children().size() == 2);
         assert(tree.Find(10));
         assert(tree.Find(20));
         assert(tree.Find(30));
@@ -154,7 +156,7 @@ public:
         assert(tree.Find(30));
         // Root should still be [20], right child [30]
         assert(tree.root->keys.size() == 2);
-        assert(tree.root->childs.size() == 0); // Only right child remains? Or both?
+        assert(tree.root->Children().size() == 0); // Only right child remains? Or both?
         // Actually: after deleting 10, left child is gone → but 2-3 tree should still have 2 children?
         // Wait—this might cause underflow! Let's build a safer case.
 
@@ -235,7 +237,7 @@ public:
         // Only 40 remains → should be root 2-node (single key)
         assert(tree.Find(40));
         assert(!tree.Find(50));
-        assert(tree.root->childs.empty()); // Leaf
+        assert(tree.root->Children().empty()); // Leaf
         assert(IsValidTree(tree));
 
         // Now delete last key
@@ -300,6 +302,37 @@ public:
         assert(IsValidTree(tree));
     }
 
+    void TestFindAsync() {
+        TwoThreeTree<int> tree;
+        std::vector<int> keys;
+        for (int i = 0; i < 2000; ++i) {
+            if (i % 3 != 0) tree.Insert(i);
+            keys.push_back(i);
+        }
+        assert(tree.FindAsync(1).Get());
+        assert(!tree.FindAsync(3).Get());
+        std::vector<bool> found = FindInterleaved(tree, keys, 8);
+        for (int i = 0; i < 2000; ++i) {
+            assert(found[i] == (i % 3 != 0));
+        }
+    }
+
+    void TestStringKeys() {
+        // inline keys must construct, move and destroy non-trivial keys correctly
+        TwoThreeTree<std::string> tree;
+        for (int i = 0; i < 1000; ++i) {
+            tree.Insert("key_with_a_long_prefix_" + std::to_string(i * 7 % 1000));
+        }
+        for (int i = 0; i < 1000; i += 3) {
+            tree.Delete("key_with_a_long_prefix_" + std::to_string(i));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            assert(tree.Find("key_with_a_long_prefix_" + std::to_string(i)) == (i % 3 != 0));
+        }
+        assert(tree.Size() == 666);
+        assert(tree.Stats().splits > 0 && tree.Stats().merges > 0);
+    }
+
     void RunTests() {
         TestEmptyTree();
         TestInsertBasic();
@@ -317,6 +350,8 @@ public:
         // TestDeleteShrinksTree();
         // TestDeleteNonExistent();
         TestDeleteManyRandom();
+        TestFindAsync();
+        TestStringKeys();
 
         std::cout<<"Ok!\n";
     }
@@ -0,0 +1,71 @@
+#ifndef MY_TREE_AGGREGATE
+#define MY_TREE_AGGREGATE
+
+#include<algorithm>
+#include<limits>
+
+
+// Augmentations of BTree, its Augment parameter: a monoid over the stored
+// keys. Every node caches the aggregate of its subtree, so Aggregate(lo, hi)
+// combines whole subtrees and only looks into the nodes on the two edges of
+// the range. An augmentation provides
+//     using Value = ...;
+//     static Value Identity();
+//     static Value Of(const T& key);
+//     static Value Combine(const Value& left, const Value& right);
+// where Combine is associative and Identity neutral to it. Combine is always
+// given its operands in key order, it need not commute. Of sees the whole
+// stored key, so keys carrying a payload (compared by their key part only,
+// like Counted) aggregate the payload.
+
+// No aggregates: nodes keep no Value and updates do no work.
+struct NoAugment {
+    struct Value {};
+};
+
+template <typename T>
+struct SumOf {
+    using Value = T;
+
+    static Value Identity() {
+        return T();
+    }
+    static Value Of(const T& key) {
+        return key;
+    }
+    static Value Combine(const Value& left, const Value& right) {
+        return left + right;
+    }
+};
+
+template <typename T>
+struct MinOf {
+    using Value = T;
+
+    static Value Identity() {
+        return std::numeric_limits<T>::max();
+    }
+    static Value Of(const T& key) {
+        return key;
+    }
+    static Value Combine(const Value& left, const Value& right) {
+        return std::min(left, right);
+    }
+};
+
+template <typename T>
+struct MaxOf {
+    using Value = T;
+
+    static Value Identity() {
+        return std::numeric_limits<T>::lowest();
+    }
+    static Value Of(const T& key) {
+        return key;
+    }
+    static Value Combine(const Value& left, const Value& right) {
+        return std::max(left, right);
+    }
+};
+
+#endif
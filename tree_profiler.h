@@ -0,0 +1,297 @@
+#ifndef MY_TREE_PROFILER
+#define MY_TREE_PROFILER
+
+#include<algorithm>
+#include<chrono>
+#include<cstdint>
+#include<cstring>
+#include<iomanip>
+#include<ostream>
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+    #include<linux/perf_event.h>
+    #include<sys/ioctl.h>
+    #include<sys/syscall.h>
+    #include<unistd.h>
+    #define MY_TREE_PROFILER_PERF 1
+#endif
+
+
+enum class TreeOp { kFind, kInsert, kDelete, kCount };
+
+// Per-level profile of tree operations on the calling thread. One in
+// SamplePeriod() operations is measured: whenever the operation reaches the
+// next node, the time and hardware counters since the previous node are
+// charged to the previous node's level. Counters come from perf_event_open
+// and are left out when the kernel refuses them; timing always works.
+//
+// Trees call it through the PROFILE_* macros below, which compile to nothing
+// unless ENABLE_PROFILING is defined (make PROFILE=1).
+class TreeProfiler {
+public:
+    static constexpr int kMaxLevels = 32;
+    enum Counter { kCycles, kL1Misses, kLlcMisses, kBranchMisses, kCounters };
+
+    struct LevelProfile {
+        std::uint64_t visits = 0;
+        std::uint64_t nanoseconds = 0;
+        std::uint64_t comparisons = 0;
+        std::uint64_t counters[kCounters] = {};
+    };
+
+    // one operation, nested operations are charged to the enclosing one
+    class OpScope {
+    public:
+        explicit OpScope(TreeOp op) : profiler_(ThisThread()) {
+            profiler_.Begin(op);
+        }
+        ~OpScope() {
+            profiler_.End();
+        }
+        OpScope(const OpScope&) = delete;
+        OpScope& operator=(const OpScope&) = delete;
+    private:
+        TreeProfiler& profiler_;
+    };
+
+    static TreeProfiler& ThisThread() {
+        thread_local TreeProfiler profiler;
+        return profiler;
+    }
+
+    TreeProfiler(const TreeProfiler&) = delete;
+    TreeProfiler& operator=(const TreeProfiler&) = delete;
+    ~TreeProfiler() {
+#ifdef MY_TREE_PROFILER_PERF
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    // a new root-to-leaf walk of the current operation starts at first_level
+    void Descent(int first_level = 0) {
+        if (!Measuring()) {
+            return;
+        }
+        Charge();
+        level_ = first_level - 1;
+    }
+    // the current operation reached the next node of its walk
+    void Visit() {
+        if (!Measuring()) {
+            return;
+        }
+        Charge();
+        level_ = std::min(level_ + 1, kMaxLevels - 1);
+    }
+    void Comparisons(std::size_t count) {
+        if (Measuring() && level_ >= 0) {
+            levels_[Index(op_)][level_].comparisons += count;
+        }
+    }
+
+    void SetSamplePeriod(std::uint32_t period) {
+        period_ = period == 0 ? 1 : period;
+    }
+    std::uint32_t SamplePeriod() const {
+        return period_;
+    }
+    bool HasCounter(Counter counter) const {
+        return slot_[counter] >= 0;
+    }
+    std::uint64_t Operations(TreeOp op) const {
+        return operations_[Index(op)];
+    }
+    std::uint64_t SampledOperations(TreeOp op) const {
+        return sampled_[Index(op)];
+    }
+    const LevelProfile& Level(TreeOp op, int level) const {
+        return levels_[Index(op)][level];
+    }
+    void Reset() {
+        for (int op = 0; op < kOps; ++op) {
+            operations_[op] = 0;
+            sampled_[op] = 0;
+            for (auto& level : levels_[op]) {
+                level = LevelProfile();
+            }
+        }
+        tick_ = 0;
+    }
+
+    void Report(std::ostream& os) const {
+        static const char* const kOpNames[] = {"Find", "Insert", "Delete"};
+        static const char* const kCounterNames[] = {"cycles", "L1-miss", "LLC-miss", "br-miss"};
+        os << "Tree profile: 1 in " << period_ << " operations sampled, per level averages per visit";
+        if (!HasCounter(kCycles) && !HasCounter(kL1Misses) && !HasCounter(kLlcMisses) && !HasCounter(kBranchMisses)) {
+            os << ", timing only (perf_event_open unavailable)";
+        }
+        os << '\n' << std::left << std::setw(8) << "op" << std::right << std::setw(6) << "level"
+           << std::setw(10) << "visits" << std::setw(10) << "ns" << std::setw(8) << "cmp";
+        for (int c = 0; c < kCounters; ++c) {
+            if (HasCounter(static_cast<Counter>(c))) {
+                os << std::setw(10) << kCounterNames[c];
+            }
+        }
+        os << '\n' << std::fixed << std::setprecision(1);
+        for (int op = 0; op < kOps; ++op) {
+            if (operations_[op] == 0) {
+                continue;
+            }
+            os << std::left << std::setw(8) << kOpNames[op] << std::right
+               << operations_[op] << " operations, " << sampled_[op] << " sampled\n";
+            for (int level = 0; level < kMaxLevels; ++level) {
+                const LevelProfile& profile = levels_[op][level];
+                if (profile.visits == 0) {
+                    continue;
+                }
+                double visits = static_cast<double>(profile.visits);
+                os << std::setw(8) << "" << std::setw(6) << level << std::setw(10) << profile.visits
+                   << std::setw(10) << profile.nanoseconds / visits
+                   << std::setw(8) << profile.comparisons / visits;
+                for (int c = 0; c < kCounters; ++c) {
+                    if (HasCounter(static_cast<Counter>(c))) {
+                        os << std::setw(10) << profile.counters[c] / visits;
+                    }
+                }
+                os << '\n';
+            }
+        }
+        os.unsetf(std::ios::floatfield);
+    }
+private:
+    static constexpr int kOps = static_cast<int>(TreeOp::kCount);
+
+    struct Snapshot {
+        std::uint64_t nanoseconds = 0;
+        std::uint64_t counters[kCounters] = {};
+    };
+
+    std::uint32_t period_ = 64;
+    std::uint64_t tick_ = 0;
+    int depth_ = 0;
+    bool active_ = false;
+    TreeOp op_ = TreeOp::kFind;
+    int level_ = -1;
+    Snapshot last_;
+    std::uint64_t operations_[kOps] = {};
+    std::uint64_t sampled_[kOps] = {};
+    LevelProfile levels_[kOps][kMaxLevels];
+    // fds_[i] is the i-th opened counter, slot_[counter] its index in the group read
+    int fds_[kCounters] = {-1, -1, -1, -1};
+    int slot_[kCounters] = {-1, -1, -1, -1};
+    int opened_ = 0;
+
+    TreeProfiler() {
+        OpenCounters();
+    }
+
+    static int Index(TreeOp op) {
+        return static_cast<int>(op);
+    }
+    bool Measuring() const {
+        return active_ && depth_ == 1;
+    }
+
+    void Begin(TreeOp op) {
+        if (depth_++ > 0) {
+            return;
+        }
+        ++operations_[Index(op)];
+        if (++tick_ % period_ != 0) {
+            return;
+        }
+        ++sampled_[Index(op)];
+        active_ = true;
+        op_ = op;
+        level_ = -1;
+        last_ = Read();
+    }
+    void End() {
+        if (--depth_ > 0) {
+            return;
+        }
+        if (active_) {
+            Charge();
+            active_ = false;
+        }
+    }
+
+    void Charge() {
+        Snapshot now = Read();
+        if (level_ >= 0) {
+            LevelProfile& profile = levels_[Index(op_)][level_];
+            ++profile.visits;
+            profile.nanoseconds += now.nanoseconds - last_.nanoseconds;
+            for (int c = 0; c < kCounters; ++c) {
+                profile.counters[c] += now.counters[c] - last_.counters[c];
+            }
+        }
+        // leave the profiler's own cost out of the next level
+        last_ = Read();
+    }
+
+    Snapshot Read() const {
+        Snapshot snapshot;
+#ifdef MY_TREE_PROFILER_PERF
+        if (opened_ > 0) {
+            std::uint64_t values[1 + kCounters] = {};
+            if (read(fds_[0], values, sizeof(values)) > 0) {
+                for (int c = 0; c < kCounters; ++c) {
+                    if (slot_[c] >= 0) {
+                        snapshot.counters[c] = values[1 + slot_[c]];
+                    }
+                }
+            }
+        }
+#endif
+        snapshot.nanoseconds = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+        return snapshot;
+    }
+
+    void OpenCounters() {
+#ifdef MY_TREE_PROFILER_PERF
+        auto cache_miss = [](std::uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        const std::uint32_t types[kCounters] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+        const std::uint64_t configs[kCounters] = {
+            PERF_COUNT_HW_CPU_CYCLES, cache_miss(PERF_COUNT_HW_CACHE_L1D),
+            cache_miss(PERF_COUNT_HW_CACHE_LL), PERF_COUNT_HW_BRANCH_MISSES};
+        for (int c = 0; c < kCounters; ++c) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[c];
+            attr.config = configs[c];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int group = opened_ > 0 ? fds_[0] : -1;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+            if (fd >= 0) {
+                fds_[opened_] = fd;
+                slot_[c] = opened_++;
+            }
+        }
+#endif
+    }
+};
+
+#ifdef ENABLE_PROFILING
+    #define PROFILE_OP(op) TreeProfiler::OpScope profile_op_scope(op)
+    #define PROFILE_DESCENT(first_level) TreeProfiler::ThisThread().Descent(first_level)
+    #define PROFILE_NODE() TreeProfiler::ThisThread().Visit()
+    #define PROFILE_COMPARISONS(count) TreeProfiler::ThisThread().Comparisons(count)
+#else
+    #define PROFILE_OP(op) do {} while(0)
+    #define PROFILE_DESCENT(first_level) do {} while(0)
+    #define PROFILE_NODE() do {} while(0)
+    #define PROFILE_COMPARISONS(count) do {} while(0)
+#endif
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef MY_TREE_STATS
+#define MY_TREE_STATS
+
+#include<cstddef>
+
+
+// Structural work done by a tree since its construction.
+struct TreeStats {
+    std::size_t splits = 0;
+    std::size_t merges = 0;
+    std::size_t rotations = 0;
+};
+#endif